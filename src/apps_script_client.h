@@ -0,0 +1,295 @@
+/**
+ * Apps Script Client
+ * Handles the /exec redirect itself and keeps one connection per Apps Script host
+ *
+ * A web app call runs the script on script.google.com, which answers 302 with a
+ * single-use echo URL on script.googleusercontent.com holding the output. The
+ * echo URL cannot be cached, so what is reused is the connection to each host:
+ * - POST: the 302 already means doPost ran, so the echo is not fetched (1 round trip)
+ * - GET: the echo is fetched over the kept-alive googleusercontent connection
+ * Permanent redirects (301/308) are the only ones whose target is remembered
+ * Both hosts are verified against GTS Root R4 and resume their TLS sessions
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <http_policy.h>
+#include <tls_roots.h>
+#include <tls_session.h>
+
+// Close a kept-alive connection after this long unused, returning its TLS buffers to the heap
+#ifndef APPS_SCRIPT_IDLE_CLOSE_MS
+#define APPS_SCRIPT_IDLE_CLOSE_MS 60000
+#endif
+
+#define APPS_SCRIPT_URL_SIZE 256
+
+// Keeps the start of a response body in a caller's fixed buffer and drops the rest,
+// so short replies (doPost's JSON) are read without a heap String
+class ReplyBuffer : public Stream {
+ public:
+  ReplyBuffer(char *buffer, size_t size) : buffer_(buffer), size_(size), length_(0) {
+    if (size_ > 0) {
+      buffer_[0] = '\0';
+    }
+  }
+
+  size_t write(uint8_t c) override {
+    return write(&c, 1);
+  }
+
+  size_t write(const uint8_t *data, size_t size) override {
+    if (size_ > 0 && length_ + 1 < size_) {
+      size_t copied = min(size, size_ - 1 - length_);
+      memcpy(buffer_ + length_, data, copied);
+      length_ += copied;
+      buffer_[length_] = '\0';
+    }
+    return size;
+  }
+
+  int available() override {
+    return 0;
+  }
+  int read() override {
+    return -1;
+  }
+  int peek() override {
+    return -1;
+  }
+
+ private:
+  char *buffer_;
+  size_t size_;
+  size_t length_;
+};
+
+#ifdef STANDIN_HOST
+typedef WiFiClient AppsScriptTransport;
+#else
+typedef TlsSessionClient AppsScriptTransport;
+#endif
+
+// One kept-alive connection to an Apps Script host
+struct AppsScriptHost {
+  const char *name;
+  AppsScriptTransport client;
+  HTTPClient http;
+  char host[64];
+  unsigned long last_used;
+
+  AppsScriptHost(const char *name, TlsSlot tls_slot) : name(name), last_used(0) {
+    host[0] = '\0';
+#ifndef STANDIN_HOST
+    client.configure(name, tls_slot, GTS_ROOT_R4);
+#endif
+  }
+};
+
+// Round trip accounting, read by the metrics server
+struct AppsScriptTrips {
+  volatile uint32_t requests;
+  volatile uint32_t round_trips;
+  volatile uint32_t connects;
+  volatile uint32_t permanent_hits;
+};
+
+static AppsScriptHost apps_script_exec("exec", TLS_SLOT_APPS_SCRIPT_EXEC);
+static AppsScriptHost apps_script_echo("echo", TLS_SLOT_APPS_SCRIPT_ECHO);
+static AppsScriptTrips apps_script_trips = {0, 0, 0, 0};
+
+// Held for a whole logical request: the roster sync task and the scan loop share the connections
+static SemaphoreHandle_t apps_script_lock = xSemaphoreCreateMutex();
+
+// Last permanent redirect seen from /exec
+static char apps_script_moved_from[APPS_SCRIPT_URL_SIZE] = "";
+static char apps_script_moved_to[APPS_SCRIPT_URL_SIZE] = "";
+
+/**
+ * Copy the host[:port] part of a URL
+ * @param url Absolute URL
+ * @param out Output buffer
+ * @param out_size Size of the output buffer
+ */
+void url_host(const char *url, char *out, size_t out_size) {
+  const char *start = strstr(url, "://");
+  start = start != nullptr ? start + 3 : url;
+  size_t length = strcspn(start, "/?");
+  length = min(length, out_size - 1);
+  memcpy(out, start, length);
+  out[length] = '\0';
+}
+
+/**
+ * One HTTP exchange on a kept-alive host connection, redirects not followed
+ * The response body is left unread for the caller
+ * @param host Connection to use
+ * @param url Absolute URL
+ * @param payload POST body, or nullptr for GET
+ * @param length POST body length
+ * @param budget_ms Remaining request budget
+ * @param connects Incremented when a new connection had to be opened
+ * @return HTTPClient result code
+ */
+int apps_script_exchange(AppsScriptHost &host, const char *url, const char *payload, size_t length,
+                         unsigned long budget_ms, uint8_t &connects) {
+  // A connection to another host cannot be reused
+  char target[sizeof(host.host)];
+  url_host(url, target, sizeof(target));
+  if (strcmp(target, host.host) != 0) {
+    host.client.stop();
+    strcpy(host.host, target);
+  }
+  if (!host.client.connected()) {
+    connects++;
+    apps_script_trips.connects++;
+  }
+
+  host.http.begin(host.client, url);
+  host.http.setReuse(true);
+  host.http.setFollowRedirects(HTTPC_DISABLE_FOLLOW_REDIRECTS);
+  host.http.setConnectTimeout(budget_ms);
+  host.http.setTimeout(http_timeout(budget_ms));
+
+  int httpCode;
+  if (payload != nullptr) {
+    host.http.addHeader("Content-Type", "application/json");
+    host.http.addHeader("Accept", "application/json");
+    httpCode = host.http.POST((uint8_t *)payload, length);
+  } else {
+    httpCode = host.http.GET();
+  }
+
+  apps_script_trips.round_trips++;
+  host.last_used = millis();
+  return httpCode;
+}
+
+/**
+ * Finish an exchange, keeping the connection open when the server allows it
+ * @param host Connection to release
+ * @param http_code Result of the exchange
+ * @param body Receives the whole response body (roster, config), or nullptr
+ * @param reply Receives the start of the body when body is nullptr; nullptr discards it
+ * @param reply_size Size of the reply buffer
+ */
+void apps_script_finish(AppsScriptHost &host, int http_code, String *body, char *reply = nullptr,
+                        size_t reply_size = 0) {
+  if (http_code > 0) {
+    // The body has to be consumed for the next request to find a clean stream
+    if (body != nullptr) {
+      *body = host.http.getString();
+    } else {
+      ReplyBuffer sink(reply, reply != nullptr ? reply_size : 0);
+      host.http.writeToStream(&sink);
+    }
+  }
+  host.http.end();
+  if (http_code <= 0) {
+    host.client.stop();
+  }
+}
+
+/**
+ * Send one request to the Apps Script web app
+ * A 302 to the echo URL is the answer for POST; the echo is fetched for GET,
+ * and for POST only when the caller wants the script's response
+ * @param url /exec URL
+ * @param payload POST body, or nullptr for GET
+ * @param length POST body length
+ * @param budget_ms Remaining request budget
+ * @param body Receives the response body (may be nullptr)
+ * @param reply Fixed buffer for a short response body, used instead of body (may be nullptr)
+ * @param reply_size Size of the reply buffer
+ * @return HTTPClient result code; a POST accepted through the redirect reports 200
+ */
+int apps_script_request(const char *url, const char *payload, size_t length, unsigned long budget_ms,
+                        String *body, char *reply = nullptr, size_t reply_size = 0) {
+  unsigned long started = millis();
+  uint8_t trips = 0;
+  uint8_t connects = 0;
+  const char *method = payload != nullptr ? "POST" : "GET";
+
+  apps_script_trips.requests++;
+  if (strcmp(url, apps_script_moved_from) == 0) {
+    url = apps_script_moved_to;
+    apps_script_trips.permanent_hits++;
+  }
+
+  int httpCode = apps_script_exchange(apps_script_exec, url, payload, length, budget_ms, connects);
+  trips++;
+
+  // Permanent redirect: remember it and repeat the request at the new location
+  if ((httpCode == HTTP_CODE_MOVED_PERMANENTLY || httpCode == HTTP_CODE_PERMANENT_REDIRECT) &&
+      apps_script_exec.http.getLocation().length() < APPS_SCRIPT_URL_SIZE) {
+    snprintf(apps_script_moved_from, sizeof(apps_script_moved_from), "%s", url);
+    snprintf(apps_script_moved_to, sizeof(apps_script_moved_to), "%s", apps_script_exec.http.getLocation().c_str());
+    apps_script_finish(apps_script_exec, httpCode, nullptr);
+    Serial.printf("Apps Script moved permanently to %s\n", apps_script_moved_to);
+
+    url = apps_script_moved_to;
+    unsigned long elapsed = millis() - started;
+    httpCode = apps_script_exchange(apps_script_exec, url, payload, length,
+                                    elapsed < budget_ms ? budget_ms - elapsed : 0, connects);
+    trips++;
+  }
+
+  if (httpCode == HTTP_CODE_FOUND || httpCode == HTTP_CODE_SEE_OTHER || httpCode == HTTP_CODE_TEMPORARY_REDIRECT) {
+    String location = apps_script_exec.http.getLocation();
+    apps_script_finish(apps_script_exec, httpCode, nullptr);
+
+    if (location.indexOf("/macros/echo") < 0) {
+      // Anything but the echo URL is a sign-in page: the deployment is not public
+      Serial.printf("Apps Script redirected away from the web app: %s\n", location.c_str());
+      httpCode = HTTP_CODE_FORBIDDEN;
+    } else if (payload != nullptr && body == nullptr && reply == nullptr) {
+      httpCode = HTTP_CODE_OK;
+    } else {
+      unsigned long elapsed = millis() - started;
+      httpCode = apps_script_exchange(apps_script_echo, location.c_str(), nullptr, 0,
+                                      elapsed < budget_ms ? budget_ms - elapsed : 0, connects);
+      trips++;
+      apps_script_finish(apps_script_echo, httpCode, body, reply, reply_size);
+    }
+  } else {
+    apps_script_finish(apps_script_exec, httpCode, body, reply, reply_size);
+  }
+
+  Serial.printf("Apps Script %s - HTTP %d, %u round trips, %u new connections, %lu ms\n",
+                method, httpCode, trips, connects, millis() - started);
+  return httpCode;
+}
+
+/**
+ * Take the Apps Script connections for one logical request
+ * @param wait Ticks to wait for another task to finish its request
+ * @return true if taken; release with apps_script_release()
+ */
+bool apps_script_acquire(TickType_t wait) {
+  return xSemaphoreTake(apps_script_lock, wait) == pdTRUE;
+}
+
+void apps_script_release() {
+  xSemaphoreGive(apps_script_lock);
+}
+
+/**
+ * Close connections that have sat unused for APPS_SCRIPT_IDLE_CLOSE_MS
+ * Called from the main loop while the gate is idle; skipped while a request is running
+ */
+void apps_script_release_idle() {
+  if (!apps_script_acquire(0)) {
+    return;
+  }
+  AppsScriptHost *hosts[] = {&apps_script_exec, &apps_script_echo};
+  for (AppsScriptHost *host : hosts) {
+    if (host->last_used != 0 && millis() - host->last_used > APPS_SCRIPT_IDLE_CLOSE_MS) {
+      host->client.stop();
+      host->last_used = 0;
+      Serial.printf("Apps Script %s connection closed after idle\n", host->name);
+    }
+  }
+  apps_script_release();
+}
@@ -0,0 +1,56 @@
+/**
+ * Baked Roster
+ * Member table compiled into flash for sites with a stable membership
+ *
+ * tools/gen_roster.py turns a CSV export of the Database sheet into
+ * baked_roster_data.h. Built with -D USE_BAKED_ROSTER=1, the table is the
+ * initial roster: cards are checked against it by binary search straight from
+ * flash, with no heap and no parsing at boot, until a network sync installs a
+ * downloaded roster over it.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef USE_BAKED_ROSTER
+#define USE_BAKED_ROSTER 0
+#endif
+
+// One member, all strings in flash; uid is formatted like format_uid()
+struct BakedMember {
+  const char *uid;
+  const char *dlsu_id;
+  const char *name;
+  const char *discord_username;
+};
+
+#if USE_BAKED_ROSTER
+#if !__has_include(<baked_roster_data.h>)
+#error "USE_BAKED_ROSTER needs src/baked_roster_data.h - run tools/gen_roster.py on a Database export"
+#endif
+#include <baked_roster_data.h>
+
+/**
+ * Find a card in the baked table
+ * @param uid Card UID as formatted by format_uid()
+ * @return Member entry in flash, or nullptr if the card is not listed
+ */
+const BakedMember *baked_roster_find(const char *uid) {
+  int low = 0;
+  int high = BAKED_ROSTER_COUNT - 1;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    int order = strcmp(uid, baked_roster[mid].uid);
+    if (order == 0) {
+      return &baked_roster[mid];
+    }
+    if (order < 0) {
+      high = mid - 1;
+    } else {
+      low = mid + 1;
+    }
+  }
+  return nullptr;
+}
+#endif
@@ -0,0 +1,494 @@
+/**
+ * On-Target Microbenchmarks
+ * Times roster parsing, UID lookup and formatting, embed building and frame blits
+ * Build the "bench" environment (-D RUN_BENCHMARKS=1) and read the JSON lines on Serial
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <Adafruit_SSD1306.h>
+#include <MFRC522.h>
+#include <mbedtls/base64.h>
+
+#ifndef RUN_BENCHMARKS
+#define RUN_BENCHMARKS 0
+#endif
+
+#if RUN_BENCHMARKS
+
+// Free heap left untouched by a benchmark, for the WiFi stack and the logging
+#define BENCH_HEAP_HEADROOM 16384
+
+// Per-member heap of a JSON roster parse until the first run measures it:
+// document (arena) and the installed users table with its strings
+#define BENCH_JSON_DOCUMENT_PER_MEMBER 224
+#define BENCH_TABLE_PER_MEMBER 96
+
+static size_t bench_document_per_member = BENCH_JSON_DOCUMENT_PER_MEMBER;
+static size_t bench_table_per_member = BENCH_TABLE_PER_MEMBER;
+
+/**
+ * Emit one benchmark result as a JSON line
+ * @param name Benchmark name
+ * @param size Problem size (roster members, 0 if not applicable)
+ * @param iterations Number of timed operations
+ * @param total_us Total time for all iterations
+ * @param best_us Fastest single iteration
+ */
+void bench_report(const char *name, int size, uint32_t iterations, uint64_t total_us, uint32_t best_us) {
+  Serial.printf("{\"bench\":\"%s\",\"size\":%d,\"iterations\":%u,\"mean_us\":%.2f,\"best_us\":%u,"
+                "\"free_heap\":%u,\"build\":\"%s %s\"}\n",
+                name, size, iterations, iterations > 0 ? (double)total_us / iterations : 0.0, best_us,
+                ESP.getFreeHeap(), __DATE__, __TIME__);
+}
+
+/**
+ * Emit a skipped benchmark as a JSON line
+ * @param name Benchmark name
+ * @param size Problem size
+ * @param reason Why it did not run
+ */
+void bench_skip(const char *name, int size, const char *reason) {
+  Serial.printf("{\"bench\":\"%s\",\"size\":%d,\"skipped\":\"%s\"}\n", name, size, reason);
+}
+
+/**
+ * Check that a benchmark's allocations fit in the heap as it is now
+ * @param largest_block Biggest single allocation it makes
+ * @param total Everything it holds at once
+ * @return true if it can run
+ */
+bool bench_heap_fits(size_t largest_block, size_t total) {
+  return largest_block <= ESP.getMaxAllocHeap() && total + BENCH_HEAP_HEADROOM <= ESP.getFreeHeap();
+}
+
+/**
+ * Internal RAM block the arena takes for a JSON roster parse
+ * Nothing when the block is in PSRAM or the one already held fits
+ * @param members Roster size
+ */
+size_t bench_json_arena_block(int members) {
+  size_t document = (size_t)members * bench_document_per_member;
+  if (psramFound() || document <= json_arena_stats.capacity) {
+    return 0;
+  }
+  return min(document + document / 4, (size_t)JSON_ARENA_MAX_SIZE);
+}
+
+/**
+ * Internal heap a JSON roster parse holds at its peak: the arena block, what spills past it, and the table
+ * @param members Roster size
+ */
+size_t bench_json_parse_heap(int members) {
+  size_t document = (size_t)members * bench_document_per_member;
+  size_t block = bench_json_arena_block(members);
+  size_t covered = max((size_t)json_arena_stats.capacity, block);
+  size_t beyond_arena = document > covered ? document - covered : 0;
+  return block + beyond_arena + (size_t)members * bench_table_per_member;
+}
+
+/**
+ * One element of the synthetic roster in the doGet JSON shape, with its separator
+ * @param index Member index
+ * @param out Output buffer
+ * @param out_size Output buffer size
+ * @return Text length
+ */
+int bench_roster_entry(int index, char *out, size_t out_size) {
+  return snprintf(out, out_size,
+                  "%s{\"uid\":\"%02X %02X %02X %02X\",\"dlsu_id\":\"12%06d\",\"name\":\"Member %d\","
+                  "\"discord_username\":\"member%d\",\"timestamp\":\"08:00\"}",
+                  index > 0 ? "," : "", (index >> 24) & 0xFF, (index >> 16) & 0xFF, (index >> 8) & 0xFF,
+                  index & 0xFF, index, index, index);
+}
+
+/**
+ * Size of the synthetic JSON roster
+ * @param members Number of members
+ * @return Bytes of JSON text
+ */
+size_t bench_roster_json_length(int members) {
+  char entry[160];
+  size_t length = 2;
+  for (int i = 0; i < members; i++) {
+    length += bench_roster_entry(i, entry, sizeof(entry));
+  }
+  return length;
+}
+
+/**
+ * The synthetic roster as JSON text, produced one member at a time while it is parsed
+ * A 1000-member roster is ~110 KB of text, more than the largest free block, so it is
+ * never held whole; ArduinoJson reads it through read() and readBytes()
+ */
+class BenchRosterReader {
+ public:
+  explicit BenchRosterReader(int members) : members_(members) {}
+
+  int read() {
+    return fill() ? (uint8_t)entry_[pos_++] : -1;
+  }
+
+  size_t readBytes(char *buffer, size_t length) {
+    size_t copied = 0;
+    while (copied < length && fill()) {
+      size_t chunk = min(length - copied, length_ - pos_);
+      memcpy(buffer + copied, entry_ + pos_, chunk);
+      pos_ += chunk;
+      copied += chunk;
+    }
+    return copied;
+  }
+
+ private:
+  // Format the next piece once the current one is used up: "[", each member, "]"
+  bool fill() {
+    if (pos_ < length_) {
+      return true;
+    }
+    if (next_ > members_ + 1) {
+      return false;
+    }
+    int piece = next_++;
+    if (piece == 0) {
+      length_ = snprintf(entry_, sizeof(entry_), "[");
+    } else if (piece <= members_) {
+      length_ = bench_roster_entry(piece - 1, entry_, sizeof(entry_));
+    } else {
+      length_ = snprintf(entry_, sizeof(entry_), "]");
+    }
+    pos_ = 0;
+    return true;
+  }
+
+  int members_;
+  int next_ = 0;
+  char entry_[160];
+  size_t length_ = 0;
+  size_t pos_ = 0;
+};
+
+/**
+ * Build the same synthetic roster in the doGet ?format=bin encoding
+ * @param members Number of members
+ * @return Base64 text, empty if it did not fit in memory
+ */
+String bench_roster_bin(int members) {
+  size_t raw_capacity = 6 + (size_t)members * 48;
+  uint8_t *raw = (uint8_t *)malloc(raw_capacity);
+  if (raw == nullptr) {
+    return String();
+  }
+
+  size_t length = 0;
+  raw[length++] = 'G';
+  raw[length++] = 'R';
+  raw[length++] = 'B';
+  raw[length++] = 1;
+  raw[length++] = (members >> 8) & 0xFF;
+  raw[length++] = members & 0xFF;
+
+  char field[32];
+  for (int i = 0; i < members; i++) {
+    raw[length++] = 4;
+    raw[length++] = (i >> 24) & 0xFF;
+    raw[length++] = (i >> 16) & 0xFF;
+    raw[length++] = (i >> 8) & 0xFF;
+    raw[length++] = i & 0xFF;
+
+    int sizes[3];
+    sizes[0] = snprintf(field, sizeof(field), "12%06d", i);
+    raw[length++] = sizes[0];
+    memcpy(raw + length, field, sizes[0]);
+    length += sizes[0];
+    sizes[1] = snprintf(field, sizeof(field), "Member %d", i);
+    raw[length++] = sizes[1];
+    memcpy(raw + length, field, sizes[1]);
+    length += sizes[1];
+    sizes[2] = snprintf(field, sizeof(field), "member%d", i);
+    raw[length++] = sizes[2];
+    memcpy(raw + length, field, sizes[2]);
+    length += sizes[2];
+  }
+
+  size_t encoded_size = 0;
+  mbedtls_base64_encode(nullptr, 0, &encoded_size, raw, length);
+  String text;
+  char *encoded = (char *)malloc(encoded_size);
+  if (encoded != nullptr && mbedtls_base64_encode((unsigned char *)encoded, encoded_size, &encoded_size, raw, length) == 0) {
+    text = encoded;
+  }
+  free(encoded);
+  free(raw);
+  return text;
+}
+
+/**
+ * Time binaryToHashmap() next to the JSON path and report both payload sizes
+ * @param members Roster size
+ */
+void bench_roster_binary(int members) {
+  // The raw table and its base64 text are built side by side, then the text is decoded into the users table
+  size_t raw_bytes = 6 + (size_t)members * 48;
+  size_t text_bytes = (raw_bytes + 2) / 3 * 4 + 1;
+  size_t table_bytes = (size_t)members * bench_table_per_member;
+  if (!bench_heap_fits(max(text_bytes, sizeof(UserInfo) * members), raw_bytes + text_bytes + table_bytes)) {
+    bench_skip("binary_to_hashmap", members, "heap");
+    return;
+  }
+
+  String text = bench_roster_bin(members);
+  if (text.length() == 0) {
+    bench_skip("binary_to_hashmap", members, "heap");
+    return;
+  }
+  size_t json_bytes = bench_roster_json_length(members);
+  Serial.printf("{\"bench\":\"roster_payload\",\"size\":%d,\"json_bytes\":%u,\"binary_bytes\":%u}\n",
+                members, json_bytes, text.length());
+
+  UserInfo *bench_users = nullptr;
+  int bench_count = 0;
+  const uint32_t parse_runs = members >= 1000 ? 3 : 20;
+  uint64_t total = 0;
+  uint32_t best = UINT32_MAX;
+  for (uint32_t run = 0; run < parse_runs; run++) {
+    if (bench_users != nullptr) {
+      delete[] bench_users;
+      bench_users = nullptr;
+    }
+    Serial.flush();
+    uint32_t start = micros();
+    binaryToHashmap(text, bench_users, bench_count);
+    uint32_t elapsed = micros() - start;
+    total += elapsed;
+    best = min(best, elapsed);
+  }
+  bench_report("binary_to_hashmap", members, parse_runs, total, best);
+  delete[] bench_users;
+}
+
+/**
+ * Time jsonToHashmap() and UID lookup against a synthetic roster
+ * @param members Roster size
+ */
+void bench_roster(int members) {
+  // The text is generated as it is parsed; the document and the users table live at once
+  if (!bench_heap_fits(max(sizeof(UserInfo) * members, bench_json_arena_block(members)), bench_json_parse_heap(members))) {
+    bench_skip("json_to_hashmap", members, "heap");
+    bench_skip("uid_lookup_hit", members, "heap");
+    bench_skip("uid_lookup_miss", members, "heap");
+    return;
+  }
+
+  // The parse times include generating the text; its own cost is reported to be subtracted
+  BenchRosterReader source(members);
+  uint32_t source_start = micros();
+  while (source.read() >= 0) {
+  }
+  uint32_t source_us = micros() - source_start;
+  bench_report("roster_json_source", members, 1, source_us, source_us);
+
+  UserInfo *bench_users = nullptr;
+  int bench_count = 0;
+
+  const uint32_t parse_runs = members >= 1000 ? 3 : 20;
+  uint64_t total = 0;
+  uint32_t best = UINT32_MAX;
+  for (uint32_t run = 0; run < parse_runs; run++) {
+    if (bench_users != nullptr) {
+      delete[] bench_users;
+      bench_users = nullptr;
+    }
+    // parseRosterJson logs a short line; drain the UART so it fits in its FIFO untimed
+    Serial.flush();
+    BenchRosterReader json(members);
+    uint32_t start = micros();
+    parseRosterJson(json, bench_users, bench_count);
+    uint32_t elapsed = micros() - start;
+    total += elapsed;
+    best = min(best, elapsed);
+  }
+  bench_report("json_to_hashmap", members, parse_runs, total, best);
+  if (bench_count != members) {
+    bench_skip("uid_lookup_hit", members, "parse");
+    bench_skip("uid_lookup_miss", members, "parse");
+    delete[] bench_users;
+    return;
+  }
+
+  // Lookups: last member (worst-case hit) and an unknown card
+  char hit_uid[UID_TEXT_SIZE];
+  int last = bench_count - 1;
+  snprintf(hit_uid, sizeof(hit_uid), "%02X %02X %02X %02X",
+           (last >> 24) & 0xFF, (last >> 16) & 0xFF, (last >> 8) & 0xFF, last & 0xFF);
+  const char *targets[] = {hit_uid, "FF FF FF FF"};
+  const char *names[] = {"uid_lookup_hit", "uid_lookup_miss"};
+
+  for (uint8_t t = 0; t < 2; t++) {
+    const uint32_t lookups = members >= 1000 ? 50 : 500;
+    total = 0;
+    best = UINT32_MAX;
+    volatile int found = 0;
+    for (uint32_t run = 0; run < lookups; run++) {
+      uint32_t start = micros();
+      for (int i = 0; i < bench_count; i++) {
+        if (bench_users[i].uid == targets[t]) {
+          found++;
+          break;
+        }
+      }
+      uint32_t elapsed = micros() - start;
+      total += elapsed;
+      best = min(best, elapsed);
+    }
+    bench_report(names[t], members, lookups, total, best);
+  }
+
+  // What this size really took sizes the gates of the larger ones
+  uint32_t free_with_table = ESP.getFreeHeap();
+  delete[] bench_users;
+  bench_table_per_member = max(sizeof(UserInfo), (ESP.getFreeHeap() - free_with_table) / members);
+  bench_document_per_member = max((size_t)1, json_arena_stats.last_peak / members);
+}
+
+/**
+ * Repeated JSON roster syncs through the arena, reporting heap state after the first and the last
+ * Parse, install and free like a re-sync; with the arena the largest free block should not shrink
+ * @param members Roster size
+ */
+void bench_json_arena(int members) {
+  if (!bench_heap_fits(max(sizeof(UserInfo) * members, bench_json_arena_block(members)), bench_json_parse_heap(members))) {
+    bench_skip("json_arena_resync", members, "heap");
+    return;
+  }
+
+  const uint8_t syncs = 10;
+  uint32_t free_first = 0;
+  uint32_t largest_first = 0;
+  for (uint8_t sync = 0; sync < syncs; sync++) {
+    UserInfo *bench_users = nullptr;
+    int bench_count = 0;
+    BenchRosterReader json(members);
+    parseRosterJson(json, bench_users, bench_count);
+    delete[] bench_users;
+    if (sync == 0) {
+      free_first = ESP.getFreeHeap();
+      largest_first = ESP.getMaxAllocHeap();
+    }
+  }
+  Serial.printf("{\"bench\":\"json_arena_resync\",\"size\":%d,\"syncs\":%u,\"arena_bytes\":%u,\"arena_peak\":%u,"
+                "\"spills\":%u,\"free_first\":%u,\"free_last\":%u,\"largest_block_first\":%u,"
+                "\"largest_block_last\":%u}\n",
+                members, syncs, json_arena_stats.capacity, json_arena_stats.peak, json_arena_stats.spills, free_first,
+                ESP.getFreeHeap(), largest_first, ESP.getMaxAllocHeap());
+}
+
+/**
+ * Time UID hex formatting for a 4-byte and a 7-byte UID
+ */
+void bench_format_uid() {
+  const byte sizes[] = {4, 7};
+  for (byte size : sizes) {
+    MFRC522::Uid uid;
+    uid.size = size;
+    for (byte i = 0; i < size; i++) {
+      uid.uidByte[i] = 0x1F * (i + 1);
+    }
+
+    char text[UID_TEXT_SIZE];
+    const uint32_t runs = 10000;
+    uint64_t total = 0;
+    uint32_t best = UINT32_MAX;
+    for (uint32_t run = 0; run < runs; run++) {
+      uint32_t start = micros();
+      format_uid(uid, text, sizeof(text));
+      uint32_t elapsed = micros() - start;
+      total += elapsed;
+      best = min(best, elapsed);
+    }
+    bench_report("format_uid", size, runs, total, best);
+  }
+}
+
+/**
+ * Time Discord embed payload building
+ */
+void bench_embeds() {
+  const uint32_t runs = 2000;
+  uint64_t total = 0;
+  uint32_t best = UINT32_MAX;
+  for (uint32_t run = 0; run < runs; run++) {
+    uint32_t start = micros();
+    authorized_message("Juan Dela Cruz", "juandc", "time in");
+    uint32_t elapsed = micros() - start;
+    total += elapsed;
+    best = min(best, elapsed);
+  }
+  bench_report("authorized_message", 0, runs, total, best);
+
+  total = 0;
+  best = UINT32_MAX;
+  for (uint32_t run = 0; run < runs; run++) {
+    uint32_t start = micros();
+    embed_message("Benchmark", "Plain description with \"quotes\" and\nnewlines", 0x00FF00);
+    uint32_t elapsed = micros() - start;
+    total += elapsed;
+    best = min(best, elapsed);
+  }
+  bench_report("embed_message", 0, runs, total, best);
+}
+
+/**
+ * Time animation frame blits into the display buffer and a full panel flush
+ * @param display Initialized OLED display
+ */
+void bench_frames(Adafruit_SSD1306 &display) {
+  const unsigned int frame_count = sizeof(scan_display) / sizeof(scan_display[0]);
+  const uint32_t runs = 500;
+  uint64_t total = 0;
+  uint32_t best = UINT32_MAX;
+  for (uint32_t run = 0; run < runs; run++) {
+    uint32_t start = micros();
+    display.clearDisplay();
+    display.drawBitmap(48, 16, scan_display[run % frame_count], FRAME_WIDTH, FRAME_HEIGHT, 1);
+    uint32_t elapsed = micros() - start;
+    total += elapsed;
+    best = min(best, elapsed);
+  }
+  bench_report("frame_blit", 0, runs, total, best);
+
+  const uint32_t flushes = 50;
+  total = 0;
+  best = UINT32_MAX;
+  for (uint32_t run = 0; run < flushes; run++) {
+    uint32_t start = micros();
+    display.display();
+    uint32_t elapsed = micros() - start;
+    total += elapsed;
+    best = min(best, elapsed);
+  }
+  bench_report("frame_flush", 0, flushes, total, best);
+}
+
+/**
+ * Run the whole suite once
+ * @param display Initialized OLED display
+ */
+void run_benchmarks(Adafruit_SSD1306 &display) {
+  Serial.println("{\"bench_suite\":\"start\"}");
+
+  const int roster_sizes[] = {50, 1000, 10000};
+  for (int members : roster_sizes) {
+    bench_roster(members);
+    bench_roster_binary(members);
+    bench_json_arena(members);
+  }
+  bench_format_uid();
+  bench_embeds();
+  bench_frames(display);
+
+  Serial.println("{\"bench_suite\":\"done\"}");
+}
+
+#endif
@@ -0,0 +1,59 @@
+/**
+ * Boot Timeline
+ * Milliseconds since reset at which each boot phase finished
+ * Phases finish on different tasks, so the order below is not the order they complete in
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+enum BootPhase {
+  BOOT_HARDWARE,
+  BOOT_DISPLAY,
+  BOOT_AUDIO,
+  BOOT_ROSTER_CACHE,
+  BOOT_ACCEPTING,
+  BOOT_WIFI,
+  BOOT_ROSTER_DOWNLOAD,
+  BOOT_ONLINE_NOTICE,
+  BOOT_PHASE_COUNT
+};
+
+const char *const boot_phase_names[BOOT_PHASE_COUNT] = {
+  "hardware", "display", "audio", "roster_cache", "accepting", "wifi", "roster_download", "online_notice"
+};
+
+// 0 until the phase is reached
+static volatile uint32_t boot_phase_ms[BOOT_PHASE_COUNT];
+
+/**
+ * Record that a phase finished; later calls for the same phase are ignored
+ * @param phase Boot phase
+ */
+void boot_mark(BootPhase phase) {
+  if (boot_phase_ms[phase] == 0) {
+    boot_phase_ms[phase] = max((uint32_t)(esp_timer_get_time() / 1000), (uint32_t)1);
+  }
+}
+
+/**
+ * Print the timeline, one line per phase plus a JSON line for collection
+ */
+void boot_timeline_report() {
+  Serial.println("Boot timeline (ms since reset):");
+  for (uint8_t i = 0; i < BOOT_PHASE_COUNT; i++) {
+    if (boot_phase_ms[i] != 0) {
+      Serial.printf("  %-16s %6u\n", boot_phase_names[i], boot_phase_ms[i]);
+    } else {
+      Serial.printf("  %-16s %6s\n", boot_phase_names[i], "-");
+    }
+  }
+
+  Serial.print("{\"boot_ms\":{");
+  for (uint8_t i = 0; i < BOOT_PHASE_COUNT; i++) {
+    Serial.printf("%s\"%s\":%u", i > 0 ? "," : "", boot_phase_names[i], boot_phase_ms[i]);
+  }
+  Serial.println("}}");
+}
@@ -1,11 +1,20 @@
 #include <Arduino.h>
+#include <stall_monitor.h>
 
 void scan_buzz(int buzzerPin) {
+  STALL_SCOPE_LIMIT("scan_buzz", 350);
   tone(buzzerPin, 2200, 300);
   delay(300);
 }
 
+void repeat_buzz(int buzzerPin) {
+  STALL_SCOPE_LIMIT("repeat_buzz", 100);
+  tone(buzzerPin, 2200, 60);
+  delay(60);
+}
+
 void success_buzz(int buzzerPin) {
+  STALL_SCOPE_LIMIT("success_buzz", 350);
   tone(buzzerPin, 2000, 100);
   delay(150);
   tone(buzzerPin, 2000, 100);
@@ -13,6 +22,7 @@ void success_buzz(int buzzerPin) {
 }
 
 void error_buzz(int buzzerPin) {
+  STALL_SCOPE_LIMIT("error_buzz", 2550);
   int count = 5;
   for (int i = 0; i < count; i++) {
     tone(buzzerPin, 1800, 250);
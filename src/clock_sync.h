@@ -0,0 +1,116 @@
+/**
+ * Clock Sync
+ * UTC time over SNTP, and the read-time stamps carried by scan events
+ *
+ * A scan is stamped when its card is read with the monotonic boot clock and,
+ * once SNTP has synced, the UTC time. A scan read before the first sync gets
+ * its UTC time back-dated from the boot clock when it is sent, so a record
+ * that waited in the outbox still reports when the card was read; doPost uses
+ * that time instead of its own arrival time when it falls in its trust window.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <esp_sntp.h>
+#include <esp_timer.h>
+#include <sys/time.h>
+#include <time.h>
+
+#ifndef CLOCK_NTP_SERVER
+#define CLOCK_NTP_SERVER "pool.ntp.org"
+#endif
+
+#ifndef CLOCK_NTP_SERVER_2
+#define CLOCK_NTP_SERVER_2 "time.google.com"
+#endif
+
+// Earlier than this (2024-01-01 UTC) means the clock was never set
+#define CLOCK_VALID_AFTER 1704067200L
+
+// When a card was read
+struct ScanStamp {
+  int64_t uptime_ms;
+  int64_t epoch_ms;
+};
+
+// SNTP sync counters, read by the metrics server and console
+struct ClockStats {
+  volatile uint32_t syncs;
+  volatile uint32_t last_sync_ms;
+};
+
+static ClockStats clock_stats = {0, 0};
+
+/**
+ * Milliseconds since boot, from the 64-bit esp_timer so it never wraps
+ * @return Monotonic time
+ */
+int64_t clock_uptime_ms() {
+  return esp_timer_get_time() / 1000;
+}
+
+/**
+ * Current UTC time
+ * @return Milliseconds since the Unix epoch, or 0 before the first sync
+ */
+int64_t clock_epoch_ms() {
+  struct timeval now;
+  gettimeofday(&now, nullptr);
+  if (now.tv_sec < CLOCK_VALID_AFTER) {
+    return 0;
+  }
+  return (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+// SNTP notification, runs on the lwIP task after each successful sync
+void clock_on_sync(struct timeval *tv) {
+  clock_stats.syncs++;
+  clock_stats.last_sync_ms = millis();
+  if (clock_stats.syncs == 1) {
+    char text[24];
+    time_t seconds = tv->tv_sec;
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", gmtime(&seconds));
+    Serial.printf("Clock synced over SNTP: %s UTC\n", text);
+  }
+}
+
+/**
+ * Start SNTP; the clock stays in UTC and lwIP re-syncs it every hour
+ * Call once the network is up
+ */
+void clock_sync_begin() {
+  sntp_set_time_sync_notification_cb(clock_on_sync);
+  configTime(0, 0, CLOCK_NTP_SERVER, CLOCK_NTP_SERVER_2);
+}
+
+/**
+ * Stamp taken when a card is read
+ * @return Boot-clock time, and UTC time if already synced
+ */
+ScanStamp clock_stamp() {
+  ScanStamp stamp = {clock_uptime_ms(), clock_epoch_ms()};
+  return stamp;
+}
+
+/**
+ * UTC time of a stamp, back-dated from the boot clock if it was taken before the first sync
+ * @param stamp Stamp from this boot
+ * @return Milliseconds since the Unix epoch, or 0 if the clock is still not synced
+ */
+int64_t clock_stamp_epoch_ms(const ScanStamp &stamp) {
+  if (stamp.epoch_ms != 0) {
+    return stamp.epoch_ms;
+  }
+  int64_t now = clock_epoch_ms();
+  return now == 0 ? 0 : now - (clock_uptime_ms() - stamp.uptime_ms);
+}
+
+/**
+ * Time since a stamp on the boot clock
+ * @param stamp Stamp from this boot
+ * @return Elapsed milliseconds
+ */
+uint32_t clock_stamp_age_ms(const ScanStamp &stamp) {
+  return (uint32_t)(clock_uptime_ms() - stamp.uptime_ms);
+}
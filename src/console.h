@@ -0,0 +1,167 @@
+/**
+ * Diagnostics Console
+ * Line-oriented commands on Serial, polled from the main loop without blocking
+ *
+ * Input is collected a byte at a time from whatever Serial already holds.
+ * Responses go into a ring buffer that console_flush() hands to the UART only
+ * as fast as its FIFO has room, so a long answer never stalls a scan; when the
+ * ring is full the rest of a response is dropped and counted.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+// Adds the "scan <reader_id> <uid>" command used by tools/scan_replay.py
+#ifndef SCAN_INJECT
+#define SCAN_INJECT 0
+#endif
+
+#ifndef CONSOLE_OUTPUT_SIZE
+#define CONSOLE_OUTPUT_SIZE 2048
+#endif
+
+#define CONSOLE_LINE_SIZE 64
+
+// One console command; args points past the command name and its space ("" if none)
+struct ConsoleCommand {
+  const char *name;
+  const char *usage;
+  void (*handler)(const char *args);
+};
+
+static const ConsoleCommand *console_commands = nullptr;
+static size_t console_command_count = 0;
+static char console_line[CONSOLE_LINE_SIZE];
+static size_t console_line_length = 0;
+static bool console_line_overflow = false;
+static char console_output[CONSOLE_OUTPUT_SIZE];
+static size_t console_output_head = 0;
+static size_t console_output_count = 0;
+static uint32_t console_output_dropped = 0;
+
+/**
+ * Queue formatted text for the console
+ * Text that does not fit in the ring is dropped
+ */
+void console_printf(const char *format, ...) {
+  char text[160];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if (length < 0) {
+    return;
+  }
+  length = min(length, (int)sizeof(text) - 1);
+
+  for (int i = 0; i < length; i++) {
+    if (console_output_count == sizeof(console_output)) {
+      console_output_dropped += length - i;
+      return;
+    }
+    console_output[(console_output_head + console_output_count) % sizeof(console_output)] = text[i];
+    console_output_count++;
+  }
+}
+
+/**
+ * Hand queued output to the UART, only as much as its transmit FIFO takes right now
+ */
+void console_flush() {
+  static uint32_t reported_dropped = 0;
+  if (console_output_dropped != reported_dropped && console_output_count == 0) {
+    reported_dropped = console_output_dropped;
+    console_printf("[console: %u bytes dropped]\n", reported_dropped);
+  }
+
+  while (console_output_count > 0) {
+    size_t room = Serial.availableForWrite();
+    if (room == 0) {
+      return;
+    }
+    // Contiguous run up to the end of the ring
+    size_t run = min(console_output_count, sizeof(console_output) - console_output_head);
+    run = min(run, room);
+    Serial.write((const uint8_t *)console_output + console_output_head, run);
+    console_output_head = (console_output_head + run) % sizeof(console_output);
+    console_output_count -= run;
+  }
+}
+
+void console_help() {
+  console_printf("Commands:\n");
+  for (size_t i = 0; i < console_command_count; i++) {
+    console_printf("  %s\n", console_commands[i].usage);
+  }
+}
+
+/**
+ * Run one complete line
+ * @param line Command line without its newline
+ */
+void console_dispatch(char *line) {
+  while (*line == ' ') {
+    line++;
+  }
+  if (*line == '\0') {
+    return;
+  }
+  size_t name_length = strcspn(line, " ");
+  const char *args = line[name_length] == ' ' ? line + name_length + 1 : "";
+
+  for (size_t i = 0; i < console_command_count; i++) {
+    const ConsoleCommand &command = console_commands[i];
+    if (strlen(command.name) == name_length && strncmp(line, command.name, name_length) == 0) {
+      command.handler(args);
+      return;
+    }
+  }
+  if (name_length == 4 && strncmp(line, "help", 4) == 0) {
+    console_help();
+    return;
+  }
+  console_printf("Unknown command '%.*s' - try help\n", (int)name_length, line);
+}
+
+/**
+ * Read pending Serial input, run any complete command and push out queued output
+ * A line too long for the buffer is dropped at its newline rather than run cut short
+ * Never waits for input or for the UART
+ */
+void console_poll() {
+  while (Serial.available() > 0) {
+    char c = Serial.read();
+    if (c == '\r') {
+      continue;
+    }
+    if (c != '\n') {
+      if (console_line_length < sizeof(console_line) - 1) {
+        console_line[console_line_length++] = c;
+      } else {
+        console_line_overflow = true;
+      }
+      continue;
+    }
+    console_line[console_line_length] = '\0';
+    console_line_length = 0;
+    if (console_line_overflow) {
+      console_line_overflow = false;
+      console_printf("line longer than %u characters ignored\n", CONSOLE_LINE_SIZE - 1);
+      continue;
+    }
+    console_dispatch(console_line);
+  }
+  console_flush();
+}
+
+/**
+ * Install the command table
+ * @param commands Commands, in the order help lists them
+ * @param count Number of commands
+ */
+void console_begin(const ConsoleCommand *commands, size_t count) {
+  console_commands = commands;
+  console_command_count = count;
+}
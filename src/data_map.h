@@ -1,37 +1,38 @@
+#pragma once
+
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include <json_arena.h>
+#include <roster_binary.h>
+#include <user_info.h>
 
-// Struct to hold individual user info
-struct UserInfo {
-  String uid;
-  String dlsu_id;
-  String name;
-  String discord_username;
-};
-
-// Function to parse the JSON and fill the users array
-void jsonToHashmap(String json, UserInfo *&users, int &userCount) {
-  Serial.println("JSON length: " + String(json.length()) + " bytes");
-  
-  // Allocate the memory for parsing the JSON - use DynamicJsonDocument for larger data
-  const size_t capacity = json.length() + 1024; // Extra space for parsing overhead
-  DynamicJsonDocument doc(capacity);
+// Roster version - FNV-1a hash of the raw roster text, so gates can be compared
+uint32_t roster_version(const String &json) {
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < json.length(); i++) {
+    hash = (hash ^ (uint8_t)json[i]) * 16777619UL;
+  }
+  return hash;
+}
 
-  // Deserialize the JSON document directly from String (more efficient)
-  DeserializationError error = deserializeJson(doc, json);
+/**
+ * Parse a JSON roster array and fill the users array
+ * @param input Anything deserializeJson() reads: the roster text, or a reader that produces it
+ * @param users Receives the new array on success
+ * @param userCount Receives the member count, 0 on failure
+ * @return Parse result
+ */
+template <typename TInput>
+DeserializationError parseRosterJson(TInput &&input, UserInfo *&users, int &userCount) {
+  // The document lives in the shared arena, sized from the largest roster parsed so far
+  JsonArenaLease arena(json_arena_roster_size());
+  JsonDocument doc(arena.allocator());
 
-  // Check if parsing succeeded
+  // Deserialize the JSON document directly from the input (more efficient)
+  DeserializationError error = deserializeJson(doc, input);
   if (error) {
-    Serial.print(F("deserializeJson() failed: "));
-    Serial.println(error.f_str());
-    Serial.println("Error code: " + String(error.code()));
-    Serial.println("First 200 characters of JSON:");
-    Serial.println(json.substring(0, 200));
-    Serial.println("Last 200 characters of JSON:");
-    Serial.println(json.substring(json.length() - 200));
-    
     userCount = 0;
-    return;
+    return error;
   }
 
   // Get the JSON array from the parsed document
@@ -50,4 +51,23 @@ void jsonToHashmap(String json, UserInfo *&users, int &userCount) {
     users[i].name = arr[i]["name"].as<String>();
     users[i].discord_username = arr[i]["discord_username"].as<String>();
   }
-}
\ No newline at end of file
+  return error;
+}
+
+// Function to parse the JSON and fill the users array
+void jsonToHashmap(const String &json, UserInfo *&users, int &userCount) {
+  Serial.println("JSON length: " + String(json.length()) + " bytes");
+
+  DeserializationError error = parseRosterJson(json, users, userCount);
+
+  // Check if parsing succeeded
+  if (error) {
+    Serial.print(F("deserializeJson() failed: "));
+    Serial.println(error.f_str());
+    Serial.println("Error code: " + String(error.code()));
+    Serial.println("First 200 characters of JSON:");
+    Serial.println(json.substring(0, 200));
+    Serial.println("Last 200 characters of JSON:");
+    Serial.println(json.substring(json.length() - 200));
+  }
+}
@@ -0,0 +1,126 @@
+/**
+ * Denied Card Cache
+ * Bounded table of recently denied UIDs, so a foreign card waved at the gate
+ * costs one full denial per window instead of one per read
+ *
+ * The first denial of a window is handled as before (record, alert, error tone).
+ * Repeats inside the window are counted and only get local feedback; when the
+ * window closes, one aggregated alert with the attempt count is sent for it
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef DENY_WINDOW_MS
+#define DENY_WINDOW_MS 60000
+#endif
+
+#ifndef DENY_CACHE_SLOTS
+#define DENY_CACHE_SLOTS 16
+#endif
+
+// Recently denied card and its attempts in the current window
+struct DeniedCard {
+  char uid[32];
+  unsigned long window_start;
+  unsigned long last_at;
+  uint32_t attempts;
+  bool summarized;
+};
+
+// Counters, read by the metrics server
+struct DenyStats {
+  volatile uint32_t suppressed;
+  volatile uint32_t summaries;
+  volatile uint32_t evicted_pending;
+};
+
+static DeniedCard denied_cards[DENY_CACHE_SLOTS];
+static DenyStats deny_stats = {0, 0, 0};
+
+/**
+ * Count a denial of a UID
+ * @param uid Formatted card UID
+ * @return true if this is a repeat inside the UID's window and must be handled locally only
+ */
+bool deny_cache_record(const char *uid) {
+  unsigned long now = millis();
+  DeniedCard *match = nullptr;
+  DeniedCard *victim = &denied_cards[0];
+
+  for (uint8_t i = 0; i < DENY_CACHE_SLOTS; i++) {
+    DeniedCard &entry = denied_cards[i];
+    if (entry.uid[0] != '\0' && strcmp(entry.uid, uid) == 0) {
+      match = &entry;
+      break;
+    }
+    // Otherwise reuse an empty slot, or the least recently denied card
+    if (victim->uid[0] != '\0' && (entry.uid[0] == '\0' || now - entry.last_at > now - victim->last_at)) {
+      victim = &entry;
+    }
+  }
+
+  if (match != nullptr && now - match->window_start < DENY_WINDOW_MS) {
+    match->attempts++;
+    match->last_at = now;
+    deny_stats.suppressed++;
+    return true;
+  }
+
+  // New window, in place for a known card or over the victim slot
+  DeniedCard *slot = match != nullptr ? match : victim;
+  if (slot->uid[0] != '\0' && slot->attempts > 1 && !slot->summarized) {
+    deny_stats.evicted_pending++;
+  }
+  strncpy(slot->uid, uid, sizeof(slot->uid) - 1);
+  slot->uid[sizeof(slot->uid) - 1] = '\0';
+  slot->window_start = now;
+  slot->last_at = now;
+  slot->attempts = 1;
+  slot->summarized = false;
+  return false;
+}
+
+/**
+ * Find one closed window with suppressed repeats that has not been reported
+ * @param attempts Set to the attempts in that window
+ * @return UID to report, or nullptr if there is nothing to send
+ */
+const char *deny_cache_pending(uint32_t &attempts) {
+  unsigned long now = millis();
+  for (uint8_t i = 0; i < DENY_CACHE_SLOTS; i++) {
+    DeniedCard &entry = denied_cards[i];
+    if (entry.uid[0] != '\0' && !entry.summarized && entry.attempts > 1 &&
+        now - entry.window_start >= DENY_WINDOW_MS) {
+      attempts = entry.attempts;
+      return entry.uid;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * Mark the window of a UID as reported
+ * @param uid UID returned by deny_cache_pending()
+ */
+void deny_cache_summarized(const char *uid) {
+  for (uint8_t i = 0; i < DENY_CACHE_SLOTS; i++) {
+    if (strcmp(denied_cards[i].uid, uid) == 0) {
+      denied_cards[i].summarized = true;
+      deny_stats.summaries++;
+      return;
+    }
+  }
+}
+
+/**
+ * Number of cards currently tracked
+ */
+uint8_t deny_cache_size() {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < DENY_CACHE_SLOTS; i++) {
+    count += denied_cards[i].uid[0] != '\0';
+  }
+  return count;
+}
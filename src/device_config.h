@@ -0,0 +1,102 @@
+/**
+ * Device Identity and Config
+ * Stable gate ID from the factory MAC, and the per-gate settings kept in the Devices sheet
+ *
+ * Every attendance event carries the device ID so several gates can share one
+ * sheet. The settings come from doGet ?device=<id> after each roster sync and
+ * are kept in NVS, so a gate that boots offline uses its last known config.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include <scan_guard.h>
+
+// Default for server_notify: let Apps Script post the Discord embed itself,
+// so a scan needs one outbound request
+#ifndef DISCORD_VIA_APPS_SCRIPT
+#define DISCORD_VIA_APPS_SCRIPT 0
+#endif
+
+#define DEVICE_LABEL_SIZE 24
+
+// Settings an admin can change per gate from the Devices sheet
+struct DeviceConfig {
+  char label[DEVICE_LABEL_SIZE];
+  bool server_notify;
+  uint32_t cooldown_ms;
+};
+
+static DeviceConfig device_config = {"", DISCORD_VIA_APPS_SCRIPT != 0, SCAN_COOLDOWN_MS};
+static char device_id_text[16] = "";
+
+/**
+ * Gate identity, "gate-" plus the last three bytes of the factory MAC
+ * @return Device ID
+ */
+const char *device_id() {
+  if (device_id_text[0] == '\0') {
+    uint64_t mac = ESP.getEfuseMac();
+    snprintf(device_id_text, sizeof(device_id_text), "gate-%02x%02x%02x", (uint8_t)(mac >> 24),
+             (uint8_t)(mac >> 32), (uint8_t)(mac >> 40));
+  }
+  return device_id_text;
+}
+
+// Put a config into effect
+void device_config_use(const DeviceConfig &config) {
+  device_config = config;
+  scan_cooldown_ms = config.cooldown_ms;
+}
+
+/**
+ * Restore the last config fetched from the sheet
+ */
+void device_config_load() {
+  Preferences prefs;
+  prefs.begin("device", true);
+  DeviceConfig saved;
+  if (prefs.getBytesLength("config") == sizeof(saved)) {
+    prefs.getBytes("config", &saved, sizeof(saved));
+    saved.label[sizeof(saved.label) - 1] = '\0';
+    device_config_use(saved);
+  }
+  prefs.end();
+  Serial.printf("Device %s (%s), server notify %s, cooldown %u ms\n", device_id(),
+                device_config.label[0] ? device_config.label : "no label", device_config.server_notify ? "on" : "off",
+                device_config.cooldown_ms);
+}
+
+/**
+ * Apply the doGet ?device response and keep it for the next boot
+ * A setting the response leaves out (blank in the sheet) goes back to its build default
+ * @param json {"device":..,"label":..,"server_notify":..,"cooldown_ms":..}
+ * @return true if the response was for this gate and applied
+ */
+bool device_config_apply(const String &json) {
+  JsonDocument doc;
+  if (deserializeJson(doc, json) || strcmp(doc["device"] | "", device_id()) != 0) {
+    Serial.println("Device config response rejected");
+    return false;
+  }
+
+  DeviceConfig config = device_config;
+  strncpy(config.label, doc["label"] | "", sizeof(config.label) - 1);
+  config.label[sizeof(config.label) - 1] = '\0';
+  config.server_notify = doc["server_notify"] | (DISCORD_VIA_APPS_SCRIPT != 0);
+  config.cooldown_ms = constrain((uint32_t)(doc["cooldown_ms"] | (uint32_t)SCAN_COOLDOWN_MS), 500u, 60000u);
+
+  if (strcmp(config.label, device_config.label) != 0 || config.server_notify != device_config.server_notify ||
+      config.cooldown_ms != device_config.cooldown_ms) {
+    device_config_use(config);
+    Preferences prefs;
+    prefs.begin("device", false);
+    prefs.putBytes("config", &device_config, sizeof(device_config));
+    prefs.end();
+    Serial.printf("Device config updated: %s, server notify %s, cooldown %u ms\n", device_config.label,
+                  device_config.server_notify ? "on" : "off", device_config.cooldown_ms);
+  }
+  return true;
+}
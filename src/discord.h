@@ -5,91 +5,145 @@
 
 #include <Arduino.h>
 #include <HTTPClient.h>
+#include <http_policy.h>
 #include <secrets.h>
+#include <tls_roots.h>
+#include <tls_session.h>
 
 // Discord webhook configuration
-const String discord_webhook = DISCORD_API;
-const String discord_tts = DISCORD_TTS;
-
-const char *DISCORD_CERT = R"(
------BEGIN CERTIFICATE-----
-MIIDejCCAmKgAwIBAgIQf+UwvzMTQ77dghYQST2KGzANBgkqhkiG9w0BAQsFADBX
-MQswCQYDVQQGEwJCRTEZMBcGA1UEChMQR2xvYmFsU2lnbiBudi1zYTEQMA4GA1UE
-CxMHUm9vdCBDQTEbMBkGA1UEAxMSR2xvYmFsU2lnbiBSb290IENBMB4XDTIzMTEx
-NTAzNDMyMVoXDTI4MDEyODAwMDA0MlowRzELMAkGA1UEBhMCVVMxIjAgBgNVBAoT
-GUdvb2dsZSBUcnVzdCBTZXJ2aWNlcyBMTEMxFDASBgNVBAMTC0dUUyBSb290IFI0
-MHYwEAYHKoZIzj0CAQYFK4EEACIDYgAE83Rzp2iLYK5DuDXFgTB7S0md+8Fhzube
-Rr1r1WEYNa5A3XP3iZEwWus87oV8okB2O6nGuEfYKueSkWpz6bFyOZ8pn6KY019e
-WIZlD6GEZQbR3IvJx3PIjGov5cSr0R2Ko4H/MIH8MA4GA1UdDwEB/wQEAwIBhjAd
-BgNVHSUEFjAUBggrBgEFBQcDAQYIKwYBBQUHAwIwDwYDVR0TAQH/BAUwAwEB/zAd
-BgNVHQ4EFgQUgEzW63T/STaj1dj8tT7FavCUHYwwHwYDVR0jBBgwFoAUYHtmGkUN
-l8qJUC99BM00qP/8/UswNgYIKwYBBQUHAQEEKjAoMCYGCCsGAQUFBzAChhpodHRw
-Oi8vaS5wa2kuZ29vZy9nc3IxLmNydDAtBgNVHR8EJjAkMCKgIKAehhxodHRwOi8v
-Yy5wa2kuZ29vZy9yL2dzcjEuY3JsMBMGA1UdIAQMMAowCAYGZ4EMAQIBMA0GCSqG
-SIb3DQEBCwUAA4IBAQAYQrsPBtYDh5bjP2OBDwmkoWhIDDkic574y04tfzHpn+cJ
-odI2D4SseesQ6bDrarZ7C30ddLibZatoKiws3UL9xnELz4ct92vID24FfVbiI1hY
-+SW6FoVHkNeWIP0GCbaM4C6uVdF5dTUsMVs/ZbzNnIdCp5Gxmx5ejvEau8otR/Cs
-kGN+hr/W5GvT1tMBjgWKZ1i4//emhA1JG1BbPzoLJQvyEotc03lXjTaCzv8mEbep
-8RqZ7a2CPsgRbuvTPBwcOMBBmuFeU88+FSBX6+7iP0il8b4Z0QFqIwwMHfs/L6K1
-vepuoxtGzi4CZ68zJpiq1UvSqTbFJjtbD4seiMHl
------END CERTIFICATE-----
-)";
+#ifdef STANDIN_HOST
+typedef WiFiClient DiscordClient;
+const char *discord_webhook = STANDIN_HOST "/api/webhooks/standin";
+#else
+typedef TlsSessionClient DiscordClient;
+const char *discord_webhook = DISCORD_API;
+#endif
+const char *discord_tts = DISCORD_TTS;
+
+// Kept for the whole run so its TLS session can be resumed by the next message
+static DiscordClient discord_client;
+
+// Serializes webhook posts from the scan loop and the boot notice
+static SemaphoreHandle_t discord_lock = xSemaphoreCreateMutex();
+
+// Fixed buffers for outgoing webhook payloads
+#define DISCORD_PAYLOAD_SIZE 1024
+static char discord_payload[DISCORD_PAYLOAD_SIZE];
 
 /**
- * Send message to Discord webhook
- * @param content Plain text message content
- * @param embed_json JSON string for Discord embed (optional)
+ * Escape a string for use inside a JSON string literal
+ * @param in Source text
+ * @param out Output buffer
+ * @param out_size Output buffer size
+ * @return Number of characters written, excluding the terminator
  */
-void send_discord(String content, String embed_json) {
-  WiFiClientSecure *client = new WiFiClientSecure;
-  if (!client) {
-    Serial.println("Failed to create secure client for Discord");
-    return;
-  }
-  
-  client->setCACert(DISCORD_CERT);
-  HTTPClient https;
-  
-  if (https.begin(*client, discord_webhook)) {
-    https.addHeader("Content-Type", "application/json");
+size_t json_escape(const char *in, char *out, size_t out_size) {
+  size_t pos = 0;
 
-    // Construct Discord webhook payload
-    String json_payload = "{\"content\":\"" + content + 
-                         "\",\"tts\":" + discord_tts;
-    
-    if (embed_json.length() > 0) {
-      json_payload += ",\"embeds\":[" + embed_json + "]";
+  for (; *in != '\0' && pos + 1 < out_size; in++) {
+    char c = *in;
+    const char *escape = nullptr;
+    switch (c) {
+      case '"': escape = "\\\""; break;
+      case '\\': escape = "\\\\"; break;
+      case '\n': escape = "\\n"; break;
+      case '\r': escape = "\\r"; break;
+      case '\t': escape = "\\t"; break;
     }
-    json_payload += "}";
 
-    int http_code = https.POST(json_payload);
-
-    if (http_code == HTTP_CODE_OK || http_code == HTTP_CODE_NO_CONTENT) {
-      Serial.println("Discord notification sent successfully");
-    } else {
-      Serial.println("Discord notification failed - HTTP " + String(http_code));
+    if (escape != nullptr) {
+      if (pos + 3 > out_size) {
+        break;
+      }
+      out[pos++] = escape[0];
+      out[pos++] = escape[1];
+    } else if ((uint8_t)c >= 0x20) {
+      out[pos++] = c;
     }
+  }
+
+  out[pos] = '\0';
+  return pos;
+}
+
+// Discord notifications are not queued, so their budget is kept short
+const RequestPolicy discord_policy = {5000, 2, 300, 1000};
+
+/**
+ * Single webhook POST attempt with the payload in discord_payload
+ * @param context Payload length (size_t *)
+ * @param budget_ms Remaining request budget
+ * @return HTTPClient result code
+ */
+int discord_attempt(void *context, unsigned long budget_ms) {
+  size_t length = *(size_t *)context;
+#ifndef STANDIN_HOST
+  discord_client.configure("discord", TLS_SLOT_DISCORD, GTS_ROOT_R4);
+#endif
+  HTTPClient https;
+  int http_code = HTTPC_ERROR_CONNECTION_REFUSED;
 
+  if (https.begin(discord_client, discord_webhook)) {
+    https.setConnectTimeout(budget_ms);
+    https.setTimeout((uint16_t)min(budget_ms, (unsigned long)UINT16_MAX));
+    https.addHeader("Content-Type", "application/json");
+    http_code = https.POST((uint8_t *)discord_payload, length);
     https.end();
   } else {
     Serial.println("Failed to connect to Discord webhook");
   }
-  
-  delete client;
+
+  discord_client.stop();
+  return http_code;
+}
+
+/**
+ * Send message to Discord webhook
+ * @param content Plain text message content
+ * @param embed_json JSON string for Discord embed (optional)
+ * @return true if Discord accepted the message
+ */
+bool send_discord(const char *content, const char *embed_json) {
+  xSemaphoreTake(discord_lock, portMAX_DELAY);
+
+  // Construct Discord webhook payload
+  size_t length = snprintf(discord_payload, sizeof(discord_payload), "{\"content\":\"");
+  length += json_escape(content, discord_payload + length, sizeof(discord_payload) - length);
+  length += snprintf(discord_payload + length, sizeof(discord_payload) - length, "\",\"tts\":%s", discord_tts);
+
+  if (embed_json[0] != '\0' && length < sizeof(discord_payload)) {
+    length += snprintf(discord_payload + length, sizeof(discord_payload) - length, ",\"embeds\":[%s]", embed_json);
+  }
+  if (length < sizeof(discord_payload)) {
+    length += snprintf(discord_payload + length, sizeof(discord_payload) - length, "}");
+  }
+  length = min(length, sizeof(discord_payload) - 1);
+
+  RequestOutcome outcome = run_with_policy(discord_breaker, discord_policy, discord_attempt, &length);
+  xSemaphoreGive(discord_lock);
+  if (outcome == REQUEST_OK) {
+    Serial.println("Discord notification sent successfully");
+    return true;
+  }
+
+  Serial.printf("Discord notification failed (%s)\n", request_outcome_names[outcome]);
+  return false;
 }
 
 /**
  * Send plain text message to Discord
  * @param content Message text
+ * @return true if Discord accepted the message
  */
-void send_discord_message(String content) { 
-  send_discord(content, ""); 
+bool send_discord_message(const char *content) { 
+  return send_discord(content, ""); 
 }
 
 /**
  * Send embed message to Discord
  * @param embeds JSON embed string
+ * @return true if Discord accepted the message
  */
-void send_discord_embeds(String embeds) {
-  send_discord("", embeds);
+bool send_discord_embeds(const char *embeds) {
+  return send_discord("", embeds);
 }
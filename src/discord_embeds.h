@@ -4,32 +4,33 @@
  */
 
 #include <Arduino.h>
-#include <cJSON.h>
 #include <secrets.h>
 
+// Fixed buffers for embed text; one message is built at a time
+#define EMBED_DESCRIPTION_SIZE 256
+#define EMBED_JSON_SIZE 640
+static char embed_description[EMBED_DESCRIPTION_SIZE];
+static char embed_buffer[EMBED_JSON_SIZE];
+
 /**
  * Create Discord embed JSON structure
  * @param title Message title
  * @param description Message content
  * @param color Embed border color (decimal format)
- * @return JSON string for Discord embed
+ * @return JSON string for Discord embed (valid until the next call)
  */
-String embed_message(const char *title, const char *description, int color) {
-  cJSON *embed = cJSON_CreateObject();
-  cJSON *fields = cJSON_CreateArray();
-
-  cJSON_AddItemToObject(embed, "title", cJSON_CreateString(title));
-  cJSON_AddItemToObject(embed, "description", cJSON_CreateString(description));
-  cJSON_AddItemToObject(embed, "color", cJSON_CreateNumber(color));
-  cJSON_AddItemToObject(embed, "fields", fields);
+const char *embed_message(const char *title, const char *description, int color) {
+  size_t length = snprintf(embed_buffer, sizeof(embed_buffer), "{\"title\":\"");
+  length += json_escape(title, embed_buffer + length, sizeof(embed_buffer) - length);
+  length += snprintf(embed_buffer + length, sizeof(embed_buffer) - length, "\",\"description\":\"");
+  if (length < sizeof(embed_buffer)) {
+    length += json_escape(description, embed_buffer + length, sizeof(embed_buffer) - length);
+  }
+  if (length < sizeof(embed_buffer)) {
+    snprintf(embed_buffer + length, sizeof(embed_buffer) - length, "\",\"color\":%d,\"fields\":[]}", color);
+  }
 
-  char *json_string = cJSON_Print(embed);
-  String result = String(json_string);
-  
-  cJSON_Delete(embed);
-  free(json_string);
-  
-  return result;
+  return embed_buffer;
 }
 
 /**
@@ -39,46 +40,55 @@ String embed_message(const char *title, const char *description, int color) {
  * @param action_type Attendance action ("time in", "time out", or "attendance")
  * @return Discord embed JSON string
  */
-String authorized_message(String name, String username, String action_type) {
+const char *authorized_message(const char *name, const char *username, const char *action_type) {
   const char *title = "✅ [ATTENDANCE RECORDED] Automated Gatepass Message";
-  String description;
   int color;
 
   // Generate appropriate message based on action type
-  if (action_type == "time in") {
-    description = "Greetings @" + username + "!\n\n" +
-                  "**" + name + "** has successfully **timed in**. ✅";
+  if (strcmp(action_type, "time in") == 0) {
+    snprintf(embed_description, sizeof(embed_description),
+             "Greetings @%s!\n\n**%s** has successfully **timed in**. ✅", username, name);
     color = 0x0099FF; // Blue
-  } else if (action_type == "time out") {
-    description = "Goodbye @" + username + "!\n\n" +
-                  "**" + name + "** has successfully **timed out**. 👋";
+  } else if (strcmp(action_type, "time out") == 0) {
+    snprintf(embed_description, sizeof(embed_description),
+             "Goodbye @%s!\n\n**%s** has successfully **timed out**. 👋", username, name);
     color = 0x00FF00; // Green
   } else {
-    description = "Hello @" + username + "!\n\n" +
-                  "Attendance recorded for **" + name + "**. ✅";
+    snprintf(embed_description, sizeof(embed_description),
+             "Hello @%s!\n\nAttendance recorded for **%s**. ✅", username, name);
     color = 0x00FF00; // Green
   }
 
-  // Convert String to const char* for embed_message
-  unsigned char content[description.length() + 1];
-  description.getBytes(content, description.length() + 1);
-  
-  return embed_message(title, (const char *)content, color);
+  return embed_message(title, embed_description, color);
 }
 
 /**
  * Generate unauthorized access security alert message
  * @return Discord embed JSON string for security notification
  */
-String denied_message() {
+const char *denied_message() {
   const char *title = "❌ [ACCESS DENIED] Automated Gatepass Message";
-  String description = "**UNAUTHORIZED ACCESS ATTEMPT**\n\n" +
-                      String("An unregistered RFID card was used to attempt ") +
-                      String("facility access.\n The request has been **DENIED** and logged.");
+  const char *description = "**UNAUTHORIZED ACCESS ATTEMPT**\n\n"
+                            "An unregistered RFID card was used to attempt "
+                            "facility access.\n The request has been **DENIED** and logged.";
+
+  return embed_message(title, description, 0xFF0000); // Red
+}
 
-  // Convert String to const char* for embed_message
-  unsigned char content[description.length() + 1];
-  description.getBytes(content, description.length() + 1);
-  
-  return embed_message(title, (const char *)content, 0xFF0000); // Red
-}
\ No newline at end of file
+/**
+ * Generate the aggregated alert for one unregistered card presented repeatedly
+ * @param uid Card UID
+ * @param attempts Attempts in the window, including the one already alerted
+ * @param window_s Window length in seconds
+ * @return Discord embed JSON string for security notification
+ */
+const char *denied_repeat_message(const char *uid, uint32_t attempts, unsigned long window_s) {
+  const char *title = "❌ [REPEATED ACCESS DENIED] Automated Gatepass Message";
+  snprintf(embed_description, sizeof(embed_description),
+           "**REPEATED UNAUTHORIZED ACCESS ATTEMPTS**\n\n"
+           "Unregistered card `%s` was presented **%u times** within %lu seconds.\n"
+           " Only the first attempt was logged; the rest were denied at the gate.",
+           uid, attempts, window_s);
+
+  return embed_message(title, embed_description, 0xFF0000); // Red
+}
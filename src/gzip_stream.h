@@ -0,0 +1,234 @@
+/**
+ * Gzip Stream
+ * Byte-at-a-time gzip inflate on top of the ROM tinfl routines
+ *
+ * The compressed bytes are pulled from a source callback a small block at a
+ * time and inflated into the 32 KiB circular LZ window deflate requires, so
+ * the decompressed data is never held in one piece. The trailer CRC-32 and
+ * length are checked once the caller has read everything.
+ *
+ * The ROM tinfl (miniz 1.15) preloads input into its bit buffer and does not
+ * give those bytes back at the end of the deflate data, so the trailer cannot
+ * be read after what tinfl reports as consumed. Instead the last 8 bytes
+ * pulled from the source are kept, and the trailer is taken from them once the
+ * source is exhausted.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <esp_rom_crc.h>
+#include <rom/miniz.h>
+
+// Compressed bytes pulled from the source per inflate call
+#ifndef GZIP_INPUT_BLOCK
+#define GZIP_INPUT_BLOCK 256
+#endif
+
+#define GZIP_FLAG_HCRC 0x02
+#define GZIP_FLAG_EXTRA 0x04
+#define GZIP_FLAG_NAME 0x08
+#define GZIP_FLAG_COMMENT 0x10
+#define GZIP_TRAILER_SIZE 8
+
+// Inflate state for one gzip member
+struct GzipStream {
+  int (*source)(void *context);
+  void *context;
+  tinfl_decompressor *inflator;
+  uint8_t *window;
+  uint8_t input[GZIP_INPUT_BLOCK];
+  size_t input_pos;
+  size_t input_len;
+  bool source_done;
+  size_t window_pos;
+  size_t out_next;
+  size_t out_end;
+  tinfl_status status;
+  uint32_t crc;
+  uint32_t inflated;
+  uint32_t compressed;
+  uint8_t tail[GZIP_TRAILER_SIZE];
+  uint32_t low_heap;
+  bool failed;
+};
+
+/**
+ * Pull one byte from the source, keeping the last GZIP_TRAILER_SIZE of them
+ * @param gz Stream state
+ * @return Byte value, or -1 when the source is exhausted
+ */
+int gzip_pull(GzipStream &gz) {
+  int c = gz.source_done ? -1 : gz.source(gz.context);
+  if (c < 0) {
+    gz.source_done = true;
+    return -1;
+  }
+  gz.tail[gz.compressed % GZIP_TRAILER_SIZE] = c;
+  gz.compressed++;
+  return c;
+}
+
+/**
+ * Skip the gzip header (RFC 1952 section 2.3)
+ * @param gz Stream state
+ * @return false if the data is not a deflate gzip member
+ */
+bool gzip_read_header(GzipStream &gz) {
+  uint8_t header[10];
+  for (uint8_t i = 0; i < sizeof(header); i++) {
+    int c = gzip_pull(gz);
+    if (c < 0) {
+      return false;
+    }
+    header[i] = c;
+  }
+  if (header[0] != 0x1F || header[1] != 0x8B || header[2] != 8) {
+    return false;
+  }
+
+  uint8_t flags = header[3];
+  if (flags & GZIP_FLAG_EXTRA) {
+    int low = gzip_pull(gz);
+    int high = gzip_pull(gz);
+    if (low < 0 || high < 0) {
+      return false;
+    }
+    for (int i = 0; i < (high << 8 | low); i++) {
+      if (gzip_pull(gz) < 0) {
+        return false;
+      }
+    }
+  }
+  // Original file name and comment, both NUL-terminated
+  for (uint8_t flag : {GZIP_FLAG_NAME, GZIP_FLAG_COMMENT}) {
+    if (flags & flag) {
+      int c;
+      while ((c = gzip_pull(gz)) > 0) {
+      }
+      if (c < 0) {
+        return false;
+      }
+    }
+  }
+  if (flags & GZIP_FLAG_HCRC) {
+    if (gzip_pull(gz) < 0 || gzip_pull(gz) < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Start inflating a gzip member
+ * @param gz Stream state to initialize
+ * @param source Callback returning the next compressed byte, or -1 at the end
+ * @param context Opaque pointer passed to the callback
+ * @return false if the header is bad or the inflate buffers could not be allocated
+ */
+bool gzip_begin(GzipStream &gz, int (*source)(void *context), void *context) {
+  memset(&gz, 0, sizeof(gz));
+  gz.source = source;
+  gz.context = context;
+  gz.status = TINFL_STATUS_NEEDS_MORE_INPUT;
+  gz.low_heap = ESP.getFreeHeap();
+
+  if (!gzip_read_header(gz)) {
+    Serial.println("Gzip: bad header");
+    return false;
+  }
+  gz.inflator = (tinfl_decompressor *)malloc(sizeof(tinfl_decompressor));
+  gz.window = (uint8_t *)malloc(TINFL_LZ_DICT_SIZE);
+  if (gz.inflator == nullptr || gz.window == nullptr) {
+    Serial.println("Gzip: no memory for the inflate window");
+    return false;
+  }
+  tinfl_init(gz.inflator);
+  return true;
+}
+
+/**
+ * Next decompressed byte
+ * @param context GzipStream
+ * @return Byte value, or -1 at the end of the member (gz.failed is set on corrupt or truncated data)
+ */
+int gzip_next(void *context) {
+  GzipStream &gz = *(GzipStream *)context;
+
+  while (gz.out_next == gz.out_end) {
+    if (gz.status == TINFL_STATUS_DONE || gz.failed) {
+      return -1;
+    }
+
+    // Top up the block buffer from the source
+    if (gz.input_pos == gz.input_len && !gz.source_done) {
+      gz.input_pos = 0;
+      gz.input_len = 0;
+      while (gz.input_len < sizeof(gz.input)) {
+        int c = gzip_pull(gz);
+        if (c < 0) {
+          break;
+        }
+        gz.input[gz.input_len++] = c;
+      }
+      gz.low_heap = min(gz.low_heap, ESP.getFreeHeap());
+    }
+
+    size_t in_size = gz.input_len - gz.input_pos;
+    size_t out_size = TINFL_LZ_DICT_SIZE - gz.window_pos;
+    gz.status = tinfl_decompress(gz.inflator, gz.input + gz.input_pos, &in_size, gz.window,
+                                 gz.window + gz.window_pos, &out_size,
+                                 gz.source_done ? 0 : TINFL_FLAG_HAS_MORE_INPUT);
+    gz.input_pos += in_size;
+
+    if (gz.status < 0 || (gz.status == TINFL_STATUS_NEEDS_MORE_INPUT && gz.source_done && out_size == 0)) {
+      Serial.printf("Gzip: inflate failed (%d) after %u bytes\n", gz.status, gz.inflated);
+      gz.failed = true;
+      return -1;
+    }
+
+    gz.crc = esp_rom_crc32_le(gz.crc, gz.window + gz.window_pos, out_size);
+    gz.inflated += out_size;
+    gz.out_next = gz.window_pos;
+    gz.out_end = gz.window_pos + out_size;
+    gz.window_pos = (gz.window_pos + out_size) & (TINFL_LZ_DICT_SIZE - 1);
+  }
+  return gz.window[gz.out_next++];
+}
+
+/**
+ * Check the trailer once the caller has read what it needs, and free the inflate buffers
+ * @param gz Stream state
+ * @return true if the whole member inflated and matches its CRC-32 and length
+ */
+bool gzip_end(GzipStream &gz) {
+  bool ok = false;
+  if (gz.inflator != nullptr && gz.window != nullptr && !gz.failed) {
+    // Data past what the caller read still counts toward the CRC
+    while (gzip_next(&gz) >= 0) {
+    }
+    // The trailer is the last 8 bytes of the source, whatever tinfl took of them
+    while (gzip_pull(gz) >= 0) {
+    }
+    uint8_t trailer[GZIP_TRAILER_SIZE];
+    for (uint8_t i = 0; i < GZIP_TRAILER_SIZE; i++) {
+      trailer[i] = gz.tail[(gz.compressed + i) % GZIP_TRAILER_SIZE];
+    }
+    // 10 header bytes, at least 2 of deflate data, then the trailer
+    if (gz.status == TINFL_STATUS_DONE && gz.compressed >= 20) {
+      uint32_t crc = trailer[0] | trailer[1] << 8 | trailer[2] << 16 | (uint32_t)trailer[3] << 24;
+      uint32_t size = trailer[4] | trailer[5] << 8 | trailer[6] << 16 | (uint32_t)trailer[7] << 24;
+      ok = crc == gz.crc && size == gz.inflated;
+      if (!ok) {
+        Serial.printf("Gzip: trailer mismatch (crc %08X/%08X, size %u/%u)\n", crc, gz.crc, size, gz.inflated);
+      }
+    } else {
+      Serial.println("Gzip: stream ended before the trailer");
+    }
+  }
+  free(gz.inflator);
+  free(gz.window);
+  gz.inflator = nullptr;
+  gz.window = nullptr;
+  return ok;
+}
@@ -0,0 +1,64 @@
+/**
+ * Heap Telemetry
+ * Periodic free heap, minimum free heap and largest free block reporting
+ * Tracks the low-water mark of the largest block so fragmentation shows up as a number
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef HEAP_REPORT_INTERVAL_MS
+#define HEAP_REPORT_INTERVAL_MS 300000
+#endif
+
+struct HeapSnapshot {
+  uint32_t free_bytes;
+  uint32_t min_free_bytes;
+  uint32_t largest_block;
+};
+
+// Largest free block seen right after boot and its lowest value since
+static uint32_t heap_largest_block_baseline = 0;
+static uint32_t heap_largest_block_low = UINT32_MAX;
+static uint32_t heap_largest_block_drops = 0;
+
+/**
+ * Take a heap snapshot and update the largest block low-water mark
+ * @return Current heap figures
+ */
+HeapSnapshot heap_snapshot() {
+  HeapSnapshot snapshot;
+  snapshot.free_bytes = ESP.getFreeHeap();
+  snapshot.min_free_bytes = ESP.getMinFreeHeap();
+  snapshot.largest_block = ESP.getMaxAllocHeap();
+
+  if (heap_largest_block_baseline == 0) {
+    heap_largest_block_baseline = snapshot.largest_block;
+  }
+  if (snapshot.largest_block < heap_largest_block_low) {
+    if (heap_largest_block_low != UINT32_MAX) {
+      heap_largest_block_drops++;
+    }
+    heap_largest_block_low = snapshot.largest_block;
+  }
+  return snapshot;
+}
+
+/**
+ * Print heap figures on Serial at a fixed interval
+ * A growing drop count after the roster load means something on the
+ * steady-state path is still fragmenting the heap
+ */
+void heap_telemetry_report() {
+  static unsigned long last_report = 0;
+  if (last_report != 0 && millis() - last_report < HEAP_REPORT_INTERVAL_MS) {
+    return;
+  }
+  last_report = millis();
+
+  HeapSnapshot snapshot = heap_snapshot();
+  Serial.printf("Heap free=%u min_free=%u largest_block=%u largest_low=%u baseline=%u drops=%u\n",
+                snapshot.free_bytes, snapshot.min_free_bytes, snapshot.largest_block,
+                heap_largest_block_low, heap_largest_block_baseline, heap_largest_block_drops);
+}
@@ -0,0 +1,225 @@
+/**
+ * Outbound HTTP Request Policy
+ * Deadline-bounded retries with jittered exponential backoff and a per-endpoint circuit breaker
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <esp_system.h>
+#include <stall_monitor.h>
+
+// Consecutive failures that open a breaker, and how long it stays open
+#ifndef BREAKER_FAILURE_THRESHOLD
+#define BREAKER_FAILURE_THRESHOLD 3
+#endif
+
+#ifndef BREAKER_OPEN_MS
+#define BREAKER_OPEN_MS 30000
+#endif
+
+// Shortest budget worth starting another attempt with
+#define POLICY_MIN_ATTEMPT_MS 1500
+
+enum RequestOutcome {
+  REQUEST_OK,
+  REQUEST_CLIENT_ERROR,
+  REQUEST_SERVER_ERROR,
+  REQUEST_TIMEOUT,
+  REQUEST_TRANSPORT_ERROR,
+  REQUEST_BREAKER_OPEN,
+  REQUEST_BUSY,
+  REQUEST_QUEUED,
+  REQUEST_OUTCOME_COUNT
+};
+
+enum BreakerState {
+  BREAKER_CLOSED,
+  BREAKER_OPEN,
+  BREAKER_HALF_OPEN
+};
+
+const char *const request_outcome_names[REQUEST_OUTCOME_COUNT] = {
+  "ok", "client_error", "server_error", "timeout", "transport_error", "breaker_open", "busy", "queued"
+};
+
+const char *const breaker_state_names[] = {"closed", "open", "half_open"};
+
+// Per-endpoint breaker and outcome counters
+struct CircuitBreaker {
+  const char *name;
+  volatile uint8_t state;
+  uint8_t consecutive_failures;
+  unsigned long opened_at;
+  volatile uint32_t trips;
+  volatile uint32_t outcomes[REQUEST_OUTCOME_COUNT];
+};
+
+// Retry budget for one logical request
+struct RequestPolicy {
+  unsigned long deadline_ms;
+  uint8_t max_attempts;
+  unsigned long base_backoff_ms;
+  unsigned long max_backoff_ms;
+};
+
+static CircuitBreaker apps_script_breaker = {"apps_script", BREAKER_CLOSED, 0, 0, 0, {0}};
+static CircuitBreaker discord_breaker = {"discord", BREAKER_CLOSED, 0, 0, 0, {0}};
+
+/**
+ * Classify an HTTPClient result code
+ * 408 and 429 are treated as server-side trouble because retrying can succeed
+ * @param http_code Status code, or a negative HTTPC_ERROR_* value
+ * @return Request outcome
+ */
+RequestOutcome classify_http(int http_code) {
+  if (http_code == HTTPC_ERROR_READ_TIMEOUT) {
+    return REQUEST_TIMEOUT;
+  }
+  if (http_code < 0) {
+    return REQUEST_TRANSPORT_ERROR;
+  }
+  if (http_code == 408 || http_code == 429 || http_code >= 500) {
+    return REQUEST_SERVER_ERROR;
+  }
+  if (http_code >= 400) {
+    return REQUEST_CLIENT_ERROR;
+  }
+  return REQUEST_OK;
+}
+
+/**
+ * Whether a breaker is open and still inside its open period, without changing its state
+ * Lets idle-time work skip a call that would be refused anyway
+ * @param breaker Endpoint breaker
+ */
+bool breaker_blocking(const CircuitBreaker &breaker) {
+  return breaker.state == BREAKER_OPEN && millis() - breaker.opened_at < BREAKER_OPEN_MS;
+}
+
+/**
+ * Check whether a breaker lets a request through
+ * An open breaker moves to half-open once BREAKER_OPEN_MS has passed and
+ * lets a single probe request through
+ * @param breaker Endpoint breaker
+ * @return true if the request may be sent
+ */
+bool breaker_allow(CircuitBreaker &breaker) {
+  if (breaker.state == BREAKER_OPEN) {
+    if (millis() - breaker.opened_at < BREAKER_OPEN_MS) {
+      return false;
+    }
+    breaker.state = BREAKER_HALF_OPEN;
+    Serial.printf("Breaker %s half-open, probing\n", breaker.name);
+  }
+  return true;
+}
+
+/**
+ * Feed a request outcome into a breaker
+ * Client errors mean the endpoint answered, so they do not count as failures
+ * @param breaker Endpoint breaker
+ * @param outcome Outcome of one attempt
+ */
+void breaker_record(CircuitBreaker &breaker, RequestOutcome outcome) {
+  breaker.outcomes[outcome]++;
+
+  if (outcome == REQUEST_OK || outcome == REQUEST_CLIENT_ERROR) {
+    if (breaker.state != BREAKER_CLOSED) {
+      Serial.printf("Breaker %s closed\n", breaker.name);
+    }
+    breaker.state = BREAKER_CLOSED;
+    breaker.consecutive_failures = 0;
+    return;
+  }
+  if (outcome == REQUEST_BREAKER_OPEN) {
+    return;
+  }
+
+  if (breaker.consecutive_failures < 255) {
+    breaker.consecutive_failures++;
+  }
+  if (breaker.state == BREAKER_HALF_OPEN || breaker.consecutive_failures >= BREAKER_FAILURE_THRESHOLD) {
+    if (breaker.state != BREAKER_OPEN) {
+      breaker.trips++;
+      Serial.printf("Breaker %s open after %u failures\n", breaker.name, breaker.consecutive_failures);
+    }
+    breaker.state = BREAKER_OPEN;
+    breaker.opened_at = millis();
+  }
+}
+
+/**
+ * Clamp a remaining budget to an HTTPClient timeout
+ * @param budget_ms Remaining budget
+ * @return Timeout in milliseconds
+ */
+uint16_t http_timeout(unsigned long budget_ms) {
+  return (uint16_t)min(budget_ms, (unsigned long)UINT16_MAX);
+}
+
+/**
+ * Backoff before the next attempt: exponential, randomized over its upper half
+ * @param policy Retry budget
+ * @param attempt Attempts made so far (1 after the first failure)
+ * @return Delay in milliseconds
+ */
+unsigned long policy_backoff(const RequestPolicy &policy, uint8_t attempt) {
+  unsigned long ceiling = policy.base_backoff_ms << min((int)attempt - 1, 8);
+  ceiling = min(ceiling, policy.max_backoff_ms);
+  return ceiling / 2 + esp_random() % (ceiling / 2 + 1);
+}
+
+/**
+ * Run a request under a policy and breaker
+ * The attempt callback receives the remaining budget in milliseconds, should
+ * use it as its HTTP timeout and returns the HTTPClient result code
+ * @param breaker Endpoint breaker
+ * @param policy Retry budget
+ * @param attempt Callback performing one attempt
+ * @param context Opaque pointer passed to the callback
+ * @return Outcome of the last attempt
+ */
+RequestOutcome run_with_policy(CircuitBreaker &breaker, const RequestPolicy &policy,
+                               int (*attempt)(void *context, unsigned long budget_ms), void *context) {
+  unsigned long started = millis();
+  RequestOutcome outcome = REQUEST_TIMEOUT;
+
+  for (uint8_t tries = 0; tries < policy.max_attempts; tries++) {
+    if (!breaker_allow(breaker)) {
+      breaker_record(breaker, REQUEST_BREAKER_OPEN);
+      return REQUEST_BREAKER_OPEN;
+    }
+
+    unsigned long elapsed = millis() - started;
+    if (elapsed + POLICY_MIN_ATTEMPT_MS > policy.deadline_ms) {
+      break;
+    }
+
+    int http_code;
+    {
+      STALL_SCOPE_LIMIT(breaker.name, STALL_HTTP_THRESHOLD_MS);
+      http_code = attempt(context, policy.deadline_ms - elapsed);
+    }
+    outcome = classify_http(http_code);
+    breaker_record(breaker, outcome);
+
+    if (outcome == REQUEST_OK || outcome == REQUEST_CLIENT_ERROR) {
+      return outcome;
+    }
+    Serial.printf("Request to %s failed (%s, %d), attempt %u/%u\n", breaker.name,
+                  request_outcome_names[outcome], http_code, tries + 1, policy.max_attempts);
+
+    // Back off only if the budget still covers the wait plus another attempt
+    if (tries + 1 < policy.max_attempts) {
+      unsigned long wait = policy_backoff(policy, tries + 1);
+      elapsed = millis() - started;
+      if (elapsed + wait + POLICY_MIN_ATTEMPT_MS > policy.deadline_ms) {
+        break;
+      }
+      delay(wait);
+    }
+  }
+  return outcome;
+}
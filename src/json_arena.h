@@ -0,0 +1,278 @@
+/**
+ * JSON Arena
+ * One reusable block behind the ArduinoJson documents for rosters and roster deltas
+ *
+ * ArduinoJson 7 grows a document through its Allocator: variant pools and
+ * strings, extended with reallocate() as the parse goes. The arena hands those
+ * out from a single block, bump-allocated and reset when the document is done
+ * rather than freed piece by piece, so each re-sync reuses the same memory
+ * instead of churning the heap. The block is taken from PSRAM when the board
+ * has it. For a full roster its size comes from the parse high-water mark,
+ * kept in NVS, plus a quarter; a parse that outgrows it spills to the heap and
+ * the block is enlarged before the next one. The block stays reserved between
+ * parses, capped at JSON_ARENA_MAX_SIZE in internal RAM, so a sync never has to
+ * find a roster-sized hole in a heap that has fragmented since the last one;
+ * roster deltas parse in the same block.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include <esp_heap_caps.h>
+
+// Smallest block, enough for a roster delta message
+#ifndef JSON_ARENA_MIN_SIZE
+#define JSON_ARENA_MIN_SIZE 4096
+#endif
+
+// Largest block in internal RAM; past this a parse spills to the heap
+#ifndef JSON_ARENA_MAX_SIZE
+#define JSON_ARENA_MAX_SIZE 98304
+#endif
+
+// Largest block in PSRAM
+#ifndef JSON_ARENA_PSRAM_MAX_SIZE
+#define JSON_ARENA_PSRAM_MAX_SIZE 1048576
+#endif
+
+// Every allocation is preceded by its size, padded so blocks stay 8-byte aligned
+#define JSON_ARENA_HEADER 8
+
+// Arena figures, read by the metrics server and console
+struct JsonArenaStats {
+  uint32_t capacity;
+  uint32_t last_peak;
+  uint32_t peak;
+  uint32_t parses;
+  uint32_t spills;
+  uint32_t resizes;
+  bool psram;
+};
+
+static JsonArenaStats json_arena_stats = {0, 0, 0, 0, 0, 0, false};
+
+class JsonArena : public ArduinoJson::Allocator {
+ public:
+  void *allocate(size_t size) override {
+    size_t need = JSON_ARENA_HEADER + padded(size);
+    if (used_ + need > capacity_) {
+      return spill(size);
+    }
+    uint8_t *header = block_ + used_;
+    *(uint32_t *)header = size;
+    last_ = header;
+    used_ += need;
+    track();
+    return header + JSON_ARENA_HEADER;
+  }
+
+  void deallocate(void *ptr) override {
+    if (ptr == nullptr) {
+      return;
+    }
+    uint8_t *header = (uint8_t *)ptr - JSON_ARENA_HEADER;
+    if (!owns(header)) {
+      spilled_ -= *(uint32_t *)header;
+      free(header);
+      return;
+    }
+    // Only the newest block can be given back before the reset
+    if (header == last_) {
+      used_ = header - block_;
+      last_ = nullptr;
+    }
+  }
+
+  void *reallocate(void *ptr, size_t new_size) override {
+    if (ptr == nullptr) {
+      return allocate(new_size);
+    }
+    uint8_t *header = (uint8_t *)ptr - JSON_ARENA_HEADER;
+    uint32_t old_size = *(uint32_t *)header;
+
+    if (!owns(header)) {
+      uint8_t *moved = (uint8_t *)realloc(header, JSON_ARENA_HEADER + new_size);
+      if (moved == nullptr) {
+        return nullptr;
+      }
+      spilled_ = spilled_ - old_size + new_size;
+      *(uint32_t *)moved = new_size;
+      track();
+      return moved + JSON_ARENA_HEADER;
+    }
+
+    // The newest block grows or shrinks in place
+    size_t offset = header - block_;
+    if (header == last_ && offset + JSON_ARENA_HEADER + padded(new_size) <= capacity_) {
+      *(uint32_t *)header = new_size;
+      used_ = offset + JSON_ARENA_HEADER + padded(new_size);
+      track();
+      return ptr;
+    }
+    if (new_size <= old_size) {
+      *(uint32_t *)header = new_size;
+      return ptr;
+    }
+
+    void *moved = allocate(new_size);
+    if (moved != nullptr) {
+      memcpy(moved, ptr, old_size);
+      deallocate(ptr);
+    }
+    return moved;
+  }
+
+  /**
+   * Make sure the block holds at least a given size, replacing it if needed
+   * Only called between parses
+   * @param size Wanted capacity
+   */
+  void reserve(size_t size) {
+    size_t limit = psramFound() ? JSON_ARENA_PSRAM_MAX_SIZE : JSON_ARENA_MAX_SIZE;
+    size = min(max(size, (size_t)JSON_ARENA_MIN_SIZE), limit);
+    size = (size + 1023) & ~(size_t)1023;
+    if (size <= capacity_) {
+      return;
+    }
+
+    free(block_);
+    block_ = nullptr;
+    capacity_ = 0;
+    bool psram = psramFound();
+    block_ = (uint8_t *)(psram ? heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : malloc(size));
+    if (block_ == nullptr) {
+      // Every parse spills to the heap until a later attempt succeeds
+      Serial.printf("JSON arena: no %u byte block, parsing on the heap\n", size);
+      return;
+    }
+    capacity_ = size;
+    json_arena_stats.capacity = size;
+    json_arena_stats.psram = psram;
+    json_arena_stats.resizes++;
+    Serial.printf("JSON arena: %u bytes in %s\n", size, psram ? "PSRAM" : "internal RAM");
+  }
+
+  /**
+   * Forget every allocation once the document is gone
+   * @return Most memory the finished parse had in use
+   */
+  uint32_t reset() {
+    uint32_t peak = parse_peak_;
+    last_spilled_ = spilled_peak_ > 0;
+    used_ = 0;
+    last_ = nullptr;
+    parse_peak_ = 0;
+    spilled_peak_ = 0;
+    return peak;
+  }
+
+  // True if the finished parse had to use the heap
+  bool spilled() const {
+    return last_spilled_;
+  }
+
+ private:
+  static size_t padded(size_t size) {
+    return (size + JSON_ARENA_HEADER - 1) & ~(size_t)(JSON_ARENA_HEADER - 1);
+  }
+
+  bool owns(const uint8_t *header) const {
+    return block_ != nullptr && header >= block_ && header < block_ + capacity_;
+  }
+
+  void *spill(size_t size) {
+    uint8_t *header = (uint8_t *)malloc(JSON_ARENA_HEADER + size);
+    if (header == nullptr) {
+      return nullptr;
+    }
+    *(uint32_t *)header = size;
+    spilled_ += size;
+    track();
+    return header + JSON_ARENA_HEADER;
+  }
+
+  void track() {
+    parse_peak_ = max(parse_peak_, (uint32_t)(used_ + spilled_));
+    spilled_peak_ = max(spilled_peak_, spilled_);
+  }
+
+  uint8_t *block_ = nullptr;
+  size_t capacity_ = 0;
+  size_t used_ = 0;
+  uint8_t *last_ = nullptr;
+  uint32_t spilled_ = 0;
+  uint32_t spilled_peak_ = 0;
+  uint32_t parse_peak_ = 0;
+  bool last_spilled_ = false;
+};
+
+static JsonArena json_arena;
+static SemaphoreHandle_t json_arena_lock = nullptr;
+
+/**
+ * Create the lock and restore the high-water mark; the block itself is
+ * allocated by the first parse. Call from setup() before any task parses JSON
+ */
+void json_arena_begin() {
+  json_arena_lock = xSemaphoreCreateMutex();
+  Preferences prefs;
+  prefs.begin("json_arena", true);
+  json_arena_stats.peak = prefs.getUInt("peak", 0);
+  prefs.end();
+}
+
+/**
+ * Block size for a full roster parse: the high-water mark plus a quarter
+ */
+size_t json_arena_roster_size() {
+  return json_arena_stats.peak + json_arena_stats.peak / 4;
+}
+
+/**
+ * Take the arena for one document; waits while another task parses
+ * @param size Block size the document is expected to need
+ * @return Allocator to construct the JsonDocument with
+ */
+ArduinoJson::Allocator *json_arena_acquire(size_t size) {
+  xSemaphoreTake(json_arena_lock, portMAX_DELAY);
+  json_arena.reserve(size);
+  return &json_arena;
+}
+
+/**
+ * Reset the arena after the document is destroyed and hand it back
+ * A new high-water mark is saved, so the next boot starts with a block that fits
+ */
+void json_arena_release() {
+  uint32_t peak = json_arena.reset();
+  json_arena_stats.last_peak = peak;
+  json_arena_stats.parses++;
+  if (json_arena.spilled()) {
+    json_arena_stats.spills++;
+  }
+  if (peak > json_arena_stats.peak) {
+    json_arena_stats.peak = peak;
+    Preferences prefs;
+    prefs.begin("json_arena", false);
+    prefs.putUInt("peak", peak);
+    prefs.end();
+  }
+  xSemaphoreGive(json_arena_lock);
+}
+
+// Holds the arena for the lifetime of one JsonDocument; declare it before the document
+class JsonArenaLease {
+ public:
+  explicit JsonArenaLease(size_t size = JSON_ARENA_MIN_SIZE) : allocator_(json_arena_acquire(size)) {}
+  ~JsonArenaLease() {
+    json_arena_release();
+  }
+  ArduinoJson::Allocator *allocator() const {
+    return allocator_;
+  }
+
+ private:
+  ArduinoJson::Allocator *allocator_;
+};
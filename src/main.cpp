@@ -10,7 +10,6 @@
 #include <SPI.h>
 #include <WiFi.h>
 #include <Wire.h>
-#include <vector>
 #include <string.h>
 
 // Third-party Libraries
@@ -21,16 +20,35 @@
 
 // Project Headers
 #include <animations.h>
+#include <baked_roster.h>
+#include <boot_timeline.h>
 #include <buzz_tones.h>
+#include <clock_sync.h>
+#include <console.h>
 #include <data_map.h>
+#include <deny_cache.h>
+#include <device_config.h>
+#include <heap_telemetry.h>
+#include <json_arena.h>
+#include <metrics_server.h>
+#include <readers.h>
 #include <requests.h>
+#include <roster_store.h>
+#include <scan_guard.h>
+#include <scan_metrics.h>
+#include <stall_monitor.h>
 #include <secrets.h>
 #include <discord.h>
 #include <discord_embeds.h>
+#include <wifi_link.h>
+#include <benchmarks.h>
 
 // Hardware Pin Definitions
 #define RST_PIN 22
 #define SS_PIN 5
+#define SS_PIN_EXIT 4
+#define IRQ_PIN 26
+#define IRQ_PIN_EXIT 27
 #define BUZZER_PIN 25
 #define OLED_SDA 21
 #define OLED_SCL 14
@@ -45,7 +63,11 @@ const int frequency = 2000;
 const int duration = 1000;
 
 // Hardware Instances
-MFRC522 mfrc522(SS_PIN, RST_PIN);
+CardReader readers[] = {
+  CardReader(0, "entry", SS_PIN, RST_PIN, IRQ_PIN),
+  CardReader(1, "exit", SS_PIN_EXIT, RST_PIN, IRQ_PIN_EXIT),
+};
+const size_t readerCount = sizeof(readers) / sizeof(readers[0]);
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 
 // Network Configuration
@@ -53,22 +75,66 @@ const char wifi_ssid[] = WIFI_SSID;
 const char wifi_pass[] = WIFI_PW;
 
 // Global Variables
-static std::vector<String> uid_db;
-UserInfo *users;
+UserInfo *users = nullptr;
 int userCount = 0;
 int frame = 0;
+unsigned long last_frame_at = 0;
+
+// Roster swapped in by the sync task, read by the scan loop
+SemaphoreHandle_t roster_lock;
+volatile bool roster_ready = false;
+volatile uint8_t roster_sync_failures = 0;
+volatile bool roster_sync_running = false;
+bool ready_announced = false;
 
 // Function Declarations
-void connect_wifi();
-bool check_uid(const String &target_uid);
+bool install_roster(const String &json);
+bool sync_roster();
+void roster_sync_task(void *arg);
+void roster_resync_task(void *arg);
+bool lookup_member(const char *uid, MemberCard &member);
+void display_show();
+void apply_roster_delta(const char *payload, size_t length);
+void flush_denied_repeats();
+void handle_scan(CardReader &reader);
+bool process_scan(CardReader &reader, const char *uid);
+void console_stats(const char *args);
+void console_roster(const char *args);
+void console_lookup(const char *args);
+void console_sync(const char *args);
+void console_queue(const char *args);
+void console_heap(const char *args);
+void console_stalls(const char *args);
+void console_scan(const char *args);
+
+// Diagnostics console commands ("help" lists them)
+const ConsoleCommand console_commands_table[] = {
+  {"stats", "stats - scan counts, breakers and WiFi", console_stats},
+  {"roster", "roster - roster source, version and size", console_roster},
+  {"lookup", "lookup <uid> - find a card, e.g. lookup 0A 1B 2C 3D", console_lookup},
+  {"sync", "sync - download the roster again", console_sync},
+  {"queue", "queue - undelivered attendance records", console_queue},
+  {"heap", "heap - free heap and fragmentation", console_heap},
+#if STALL_MONITOR
+  {"stalls", "stalls - slowest calls and per-site timings", console_stalls},
+#endif
+#if SCAN_INJECT
+  {"scan", "scan <reader_id> <uid> - run the scan path for a card", console_scan},
+#endif
+};
 
 void setup() {
   // Initialize hardware interfaces
   Wire.begin(OLED_SDA, OLED_SCL);
   Serial.begin(9600);
   SPI.begin();
-  mfrc522.PCD_Init();
-  delay(100);
+  readers_init(readers, readerCount);
+  boot_mark(BOOT_HARDWARE);
+
+  Serial.println("\nRFID Attendance System - Initializing...");
+
+  // Association runs on core 0 from here on, overlapping the rest of boot
+  wifi_link_begin(wifi_ssid, wifi_pass);
 
   // Initialize OLED display
   if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) {
@@ -76,171 +142,323 @@ void setup() {
     while (true); // System halt on display failure
   }
   display.clearDisplay();
+  boot_mark(BOOT_DISPLAY);
 
-  Serial.println("\nRFID Attendance System - Initializing...");
+  // Initialize buzzer and audio feedback
+  pinMode(BUZZER_PIN, OUTPUT);
+  ledcSetup(0, frequency, 8);
+  ledcAttachPin(BUZZER_PIN, 0);
+  boot_mark(BOOT_AUDIO);
+
+  // Before anything parses JSON, the benchmarks included
+  json_arena_begin();
+
+#if RUN_BENCHMARKS
+  run_benchmarks(display);
+#endif
+
+  // Per-gate settings from the last sync, until the sheet is reachable
+  device_config_load();
+
+  // Admit members from the last downloaded roster while the network comes up
+  roster_lock = xSemaphoreCreateMutex();
+#if USE_BAKED_ROSTER
+  // The table compiled into flash is the initial roster; nothing to load or parse
+  roster_ready = BAKED_ROSTER_COUNT > 0;
+  gate_counters.roster_version = BAKED_ROSTER_VERSION;
+  gate_counters.roster_members = BAKED_ROSTER_COUNT;
+  Serial.printf("Baked roster: %u members in flash\n", BAKED_ROSTER_COUNT);
+  roster_store_begin();
+#else
+  if (roster_store_begin()) {
+    String cached = roster_store_load();
+    if (cached.length() > 0 && install_roster(cached)) {
+      Serial.println("Loaded cached roster from flash");
+    }
+  }
+#endif
+  boot_mark(BOOT_ROSTER_CACHE);
+
+  metrics_server_begin(readers, readerCount);
+  console_begin(console_commands_table, sizeof(console_commands_table) / sizeof(console_commands_table[0]));
+#if MQTT_TRANSPORT
+  mqtt_begin(apply_roster_delta);
+#endif
+  roster_sync_running = true;
+  xTaskCreatePinnedToCore(roster_sync_task, "roster_sync", 12288, nullptr, tskIDLE_PRIORITY + 1, nullptr, 0);
+
+  // From here on a loop() pass that hangs resets the gate
+  stall_watchdog_begin();
+}
 
-  // Establish network connection
-  connect_wifi();
-  display.clearDisplay();
+/**
+ * Parse a roster and swap it in for the one the scan loop is using
+ * @param json Roster text (JSON or the binary encoding) from Apps Script or flash
+ * @return true if the roster was valid and installed
+ */
+bool install_roster(const String &json) {
+  bool binary = roster_is_binary(json);
+  if (!binary && !(json.length() > 0 && json.startsWith("[") && json.endsWith("]"))) {
+    Serial.println("Invalid database response format");
+    return false;
+  }
 
-  // Download UID database with retry mechanism
-  bool uidsDownloaded = false;
-  int retryCount = 0;
-  const int maxRetries = 3;
-  const int retryDelay = 1000;
-
-  while (!uidsDownloaded && retryCount < maxRetries) {
-    // Ensure WiFi connection before database download
-    if (WiFi.status() != WL_CONNECTED) {
-      Serial.println("WiFi disconnected. Reconnecting...");
-      connect_wifi();
-    }
+  UserInfo *parsed = nullptr;
+  int parsedCount = 0;
+  unsigned long parse_start = micros();
+  if (binary) {
+    binaryToHashmap(json, parsed, parsedCount);
+  } else {
+    jsonToHashmap(json, parsed, parsedCount);
+  }
+  Serial.printf("Roster parsed: %u bytes of %s in %lu us\n", json.length(), binary ? "binary" : "JSON",
+                micros() - parse_start);
+  if (!binary) {
+    Serial.printf("JSON arena: parse used %u of %u bytes, largest free block %u\n", json_arena_stats.last_peak,
+                  json_arena_stats.capacity, ESP.getMaxAllocHeap());
+  }
+  if (parsedCount <= 0) {
+    Serial.println("No users found in database response");
+    delete[] parsed;
+    return false;
+  }
 
-    display.clearDisplay();
-    // Display loading animation and status
-    display.drawBitmap(48, 11, gears[frame], FRAME_WIDTH, FRAME_HEIGHT, 1);
-    display.setTextSize(1);
-    display.setTextColor(WHITE);
-    display.setCursor(20, 45);
+  Serial.println("UID Database Loaded Successfully:");
+  Serial.println("Total Users: " + String(parsedCount));
+  for (int i = 0; i < parsedCount; i++) {
+    Serial.println("  " + parsed[i].name + " (" + parsed[i].uid + ")");
+  }
 
-    if (retryCount == 0) {
-      display.print("Downloading UIDs");
-    } else {
-      display.print("Retry Attempt: " + String(retryCount + 1));
-    }
-    display.display();
-
-    // Request UID database from Google Apps Script
-    String json = spreadsheet_comm();
-    Serial.println("Database Response: " + String(json.length()) + " characters");
-
-    // Validate JSON response format
-    if (json.length() > 0 && json.startsWith("[") && json.endsWith("]")) {
-      jsonToHashmap(json, users, userCount);
-      
-      if (userCount > 0) {
-        Serial.println("UID Database Downloaded Successfully:");
-        Serial.println("Total Users: " + String(userCount));
-        
-        // Populate UID lookup vector for fast authorization checks
-        uid_db.clear();
-        for (int i = 0; i < userCount; i++) {
-          uid_db.push_back(users[i].uid);
-          Serial.println("  " + users[i].name + " (" + users[i].uid + ")");
-        }
-
-        uidsDownloaded = true;
-        
-        // Display success status
-        display.clearDisplay();
-        display.drawBitmap(48, 16, authorized[frame], FRAME_WIDTH, FRAME_HEIGHT, 1);
-        display.setTextSize(1);
-        display.setTextColor(WHITE);
-        display.setCursor(20, 50);
-        display.print("Database Ready!");
-        display.display();
-        break;
-        
-      } else {
-        Serial.println("No users found in database response");
-      }
-    } else {
-      Serial.println("Invalid database response format");
-    }
-    
-    retryCount++;
-    if (retryCount < maxRetries) {
-      Serial.println("Retrying in " + String(retryDelay) + "ms...");
-      delay(retryDelay);
-    }
+  xSemaphoreTake(roster_lock, portMAX_DELAY);
+  UserInfo *previous = users;
+  users = parsed;
+  userCount = parsedCount;
+
+  roster_ready = true;
+  xSemaphoreGive(roster_lock);
+  delete[] previous;
+
+  gate_counters.roster_version = roster_version(json);
+  gate_counters.roster_members = parsedCount;
+  return true;
+}
+
+/**
+ * Download the roster once, install it and refresh the flash copy if it changed
+ * The gate's settings are refreshed alongside; a failure there keeps the current ones
+ * @return true if a valid roster was installed
+ */
+bool sync_roster() {
+  uint32_t cached_version = gate_counters.roster_version;
+  String json = spreadsheet_comm();
+  Serial.println("Database Response: " + String(json.length()) + " characters");
+  if (!install_roster(json)) {
+    return false;
+  }
+  if (gate_counters.roster_version != cached_version && roster_store_save(json)) {
+    Serial.println("Roster saved to flash");
+  }
+  fetch_device_config();
+  return true;
+}
+
+/**
+ * Boot-time network work, off the scan loop: SNTP, roster download, flash
+ * refresh and the online notice, then the boot timeline
+ */
+void roster_sync_task(void *arg) {
+  while (WiFi.status() != WL_CONNECTED) {
+    delay(100);
+  }
+  boot_mark(BOOT_WIFI);
+  clock_sync_begin();
+
+  // Transport errors are retried inside spreadsheet_comm(); this covers bad payloads and outages
+  uint8_t rounds = 0;
+  while (!sync_roster()) {
+    roster_sync_failures = ++rounds;
+    unsigned long retryDelay = policy_backoff(roster_policy, min(rounds, (uint8_t)8));
+    Serial.println("Retrying in " + String(retryDelay) + "ms...");
+    delay(retryDelay);
+  }
+  roster_sync_failures = 0;
+  boot_mark(BOOT_ROSTER_DOWNLOAD);
+
+  String online = "Eco Archers Team Gatepass System Online. 📡 (" + String(device_id());
+  if (device_config.label[0] != '\0') {
+    online += ", " + String(device_config.label);
+  }
+  online += ")";
+  send_discord_message(online.c_str());
+  boot_mark(BOOT_ONLINE_NOTICE);
+  boot_timeline_report();
+  roster_sync_running = false;
+  vTaskDelete(nullptr);
+}
+
+/**
+ * One roster download requested from the console
+ */
+void roster_resync_task(void *arg) {
+  // Runs on core 0, so the result goes to Serial rather than the loop's console ring
+  bool installed = sync_roster();
+  Serial.printf("sync: %s\n", installed ? "roster installed" : "failed, keeping the current roster");
+  roster_sync_running = false;
+  vTaskDelete(nullptr);
+}
+
+void loop() {
+  stall_watchdog_feed();
+  STALL_SCOPE_LIMIT("loop", STALL_LOOP_THRESHOLD_MS);
+
+  // First roster in place (flash or download): cards are accepted from here
+  if (roster_ready && !ready_announced) {
+    ready_announced = true;
+    boot_mark(BOOT_ACCEPTING);
+    Serial.println("System Ready - RFID Scanner Active");
+    success_buzz(BUZZER_PIN);
   }
 
-  // Handle database download failure
-  if (!uidsDownloaded) {
-    Serial.println("CRITICAL: Failed to download UID database after " + String(maxRetries) + " attempts");
+  // Display scanning animation on its own clock, independent of card detection
+  if (millis() - last_frame_at >= FRAME_DELAY) {
+    last_frame_at = millis();
     display.clearDisplay();
-    display.drawBitmap(48, 11, denied[0], FRAME_WIDTH, FRAME_HEIGHT, 1);
     display.setTextSize(1);
     display.setTextColor(WHITE);
-    display.setCursor(15, 45);
-    display.print("Database Failed");
-    display.setCursor(25, 55);
-    display.print("Check Network");
-    display.display();
-    
-    while (true) { // System halt - requires restart
-      delay(1000);
+    unsigned int frame_count;
+    if (roster_ready) {
+      display.drawBitmap(48, 16, scan_display[frame % (sizeof(scan_display) / sizeof(scan_display[0]))],
+                         FRAME_WIDTH, FRAME_HEIGHT, 1);
+      display.setCursor(25, 50);
+      display.print("Ready to scan...");
+      frame_count = sizeof(scan_display) / sizeof(scan_display[0]);
+    } else {
+      // No roster yet: first boot without a flash copy
+      display.drawBitmap(48, 11, gears[frame % (sizeof(gears) / sizeof(gears[0]))], FRAME_WIDTH, FRAME_HEIGHT, 1);
+      display.setCursor(roster_sync_failures > 0 ? 25 : 20, 45);
+      display.print(roster_sync_failures > 0 ? "Check Network" : "Downloading UIDs");
+      frame_count = sizeof(gears) / sizeof(gears[0]);
     }
+    display_show();
+
+    // Update animation frame
+    frame = (frame + 1) % frame_count;
   }
 
-  // Initialize buzzer and audio feedback
-  pinMode(BUZZER_PIN, OUTPUT);
-  ledcSetup(0, frequency, 8);
-  ledcAttachPin(BUZZER_PIN, 0);
-  success_buzz(BUZZER_PIN);
+  readers_report(readers, readerCount);
+  SCAN_METRICS_REPORT();
+  heap_telemetry_report();
 
-  Serial.println("System Ready - RFID Scanner Active");
-  send_discord_message("Eco Archers Team Gatepass System Online. 📡");
-}
+  // Diagnostics commands, and replayed scans from tools/scan_replay.py
+  console_poll();
 
-void loop() {
-  // Display scanning animation
-  display.clearDisplay();
-  display.drawBitmap(48, 16, scan_display[frame], FRAME_WIDTH, FRAME_HEIGHT, 1);
-  display.setTextSize(1);
-  display.setTextColor(WHITE);
-  display.setCursor(25, 50);
-  display.print("Ready to scan...");
-  display.display();
-  
-  // Update animation frame
-  unsigned int frame_count = (sizeof(scan_display) / sizeof(scan_display[0]));
-  frame = (frame + 1) % frame_count;
-  delay(FRAME_DELAY);
-
-  // Check for new RFID card
-  if (!mfrc522.PICC_IsNewCardPresent() || !mfrc522.PICC_ReadCardSerial()) {
+  // Check every reader for a new RFID card
+  CardReader *reader = readers_poll(readers, readerCount);
+  if (reader == nullptr) {
+    // Retry undelivered attendance records while the gate is idle
+    drain_scan_outbox();
+    flush_denied_repeats();
+    apps_script_release_idle();
+
+    // Sleep until the next frame is due or a reader raises its IRQ line
+    unsigned long elapsed = millis() - last_frame_at;
+    readers_wait(readers, readerCount, elapsed < FRAME_DELAY ? FRAME_DELAY - elapsed : 0);
     return;
   }
 
+  handle_scan(*reader);
+  readers_done(*reader);
+}
+
+void handle_scan(CardReader &reader) {
+  MFRC522 &mfrc522 = reader.rfid;
+  SCAN_STAGE_US(STAGE_DETECT, reader.last_detect_us);
+
   // Extract UID from scanned card
-  String uid = "";
-  for (byte i = 0; i < mfrc522.uid.size; i++) {
-    uid.concat(String(mfrc522.uid.uidByte[i] < 0x10 ? " 0" : " "));
-    uid.concat(String(mfrc522.uid.uidByte[i], HEX));
-  }
-  uid.toUpperCase();
-  uid.trim();
-  
-  Serial.println("Card Scanned - UID: " + uid);
+  SCAN_TIMER(uid_start);
+  char uid[UID_TEXT_SIZE];
+  format_uid(mfrc522.uid, uid, sizeof(uid));
+  SCAN_STAGE_US(STAGE_UID_READ, reader.last_read_us + (micros() - uid_start));
+
+  bool processed = process_scan(reader, uid);
+
+  // Reset MFRC522
+  mfrc522.PICC_HaltA();
+  if (processed) {
+    delay(250);
+  }
+}
+
+/**
+ * Run the scan path for a UID: duplicate guard, lookup, notifications and feedback
+ * @param reader Reader the card was presented to
+ * @param uid Formatted card UID
+ * @return false if the scan was suppressed as a repeat
+ */
+bool process_scan(CardReader &reader, const char *uid) {
+  unsigned long started_at = millis();
+  SCAN_TIMER(scan_start);
+
+  // Nothing to check against until the first roster is in
+  if (!roster_ready) {
+    Serial.printf("Scan before roster loaded - UID: %s\n", uid);
+    repeat_buzz(BUZZER_PIN);
+    return false;
+  }
+
+  // Drop repeat reads of the same card before any network work
+  if (scan_guard_check(uid)) {
+    Serial.printf("Repeat scan ignored - UID: %s (suppressed: %u)\n", uid, scan_guard_suppressed());
+    repeat_buzz(BUZZER_PIN);
+    return false;
+  }
+
+  // Attendance time is the read time, however long the record takes to reach the sheet
+  ScanStamp read_at = clock_stamp();
+  Serial.printf("Card Scanned - UID: %s (reader %u: %s)\n", uid, reader.id, reader.label);
+  SCAN_TIMER(scan_buzz_start);
   scan_buzz(BUZZER_PIN);
+  SCAN_STAGE(STAGE_BUZZ_SCAN, scan_buzz_start);
 
   // Display verification status
+  SCAN_TIMER(verify_oled_start);
   display.clearDisplay();
   display.drawBitmap(48, 16, gears[0], FRAME_WIDTH, FRAME_HEIGHT, 1);
   display.setTextSize(1);
   display.setTextColor(WHITE);
   display.setCursor(25, 50);
   display.print("Verifying...");
-  display.display();
+  display_show();
+  SCAN_STAGE(STAGE_OLED_VERIFY, verify_oled_start);
 
   // Lookup user in local database
-  UserInfo *user = nullptr;
-  for (int i = 0; i < userCount; i++) {
-    if (users[i].uid == uid) {
-      user = &users[i];
-      break;
-    }
-  }
+  SCAN_TIMER(lookup_start);
+  MemberCard member;
+  const MemberCard *user = lookup_member(uid, member) ? &member : nullptr;
+  SCAN_STAGE(STAGE_LOOKUP, lookup_start);
 
   if (user != nullptr) {
     // Authorized user found in database
-    Serial.println("ACCESS GRANTED: " + user->name + " (" + user->discord_username + ")");
-
-    send_discord_embeds(authorized_message(user->name, user->discord_username, "attendance"));
+    gate_counters.scans_granted++;
+    Serial.printf("ACCESS GRANTED: %s (%s)\n", user->name, user->discord_username);
+
+    // Record attendance; with server-side fan-out Apps Script also notifies Discord
+    SCAN_TIMER(apps_script_start);
+    bool notified = false;
+    bool recorded = send_scan_data(uid, true, reader.id, device_config.server_notify, read_at, notified);
+    if (!recorded) {
+      SCAN_STAGE_ERROR(STAGE_APPS_SCRIPT);
+    }
+    SCAN_STAGE(STAGE_APPS_SCRIPT, apps_script_start);
 
-    // Record attendance and determine action type
-    send_scan_data(uid, true);
+    // Notify Discord directly unless the script reports it did
+    if (!notified) {
+      SCAN_TIMER(discord_start);
+      if (!send_discord_embeds(authorized_message(user->name, user->discord_username, "attendance"))) {
+        SCAN_STAGE_ERROR(STAGE_DISCORD);
+      }
+      SCAN_STAGE(STAGE_DISCORD, discord_start);
+    }
     // String actionType = response;
     // actionType.trim();
     
@@ -258,76 +476,361 @@ void loop() {
     // }
 
     // Display success feedback
+    SCAN_TIMER(result_oled_start);
     display.clearDisplay();
     display.drawBitmap(48, 16, authorized[0], FRAME_WIDTH, FRAME_HEIGHT, 1);
     display.setTextSize(1);
     display.setTextColor(WHITE);
     display.setCursor(25, 50);
     display.print(user->name);
-    display.display();
+    display_show();
+    SCAN_STAGE(STAGE_OLED_RESULT, result_oled_start);
+
+    SCAN_TIMER(result_buzz_start);
     success_buzz(BUZZER_PIN);
+    SCAN_STAGE(STAGE_BUZZ_RESULT, result_buzz_start);
 
   } else {
     // Unauthorized card scanned
-    Serial.println("ACCESS DENIED: Unknown UID " + uid);
+    gate_counters.scans_denied++;
+    Serial.printf("ACCESS DENIED: Unknown UID %s\n", uid);
+
+    // Repeats of the same card within its window: count it, deny locally, no network
+    if (deny_cache_record(uid)) {
+      Serial.printf("Repeat denial kept local - UID: %s\n", uid);
+      display.clearDisplay();
+      display.drawBitmap(48, 16, denied[0], FRAME_WIDTH, FRAME_HEIGHT, 1);
+      display.setTextSize(1);
+      display.setTextColor(WHITE);
+      display.setCursor(25, 50);
+      display.print("Access Denied");
+      display_show();
+      repeat_buzz(BUZZER_PIN);
+      return true;
+    }
 
     // Log unauthorized attempt
-    send_scan_data(uid, false);
-    delay(500);
-
-    // Send security alert to Discord
-    send_discord_embeds(denied_message());
+    SCAN_TIMER(apps_script_start);
+    bool notified = false;
+    bool recorded = send_scan_data(uid, false, reader.id, device_config.server_notify, read_at, notified);
+    if (!recorded) {
+      SCAN_STAGE_ERROR(STAGE_APPS_SCRIPT);
+    }
+    SCAN_STAGE(STAGE_APPS_SCRIPT, apps_script_start);
+
+    // Send security alert to Discord unless the script reports it did
+    if (!notified) {
+      delay(500);
+      SCAN_TIMER(discord_start);
+      if (!send_discord_embeds(denied_message())) {
+        SCAN_STAGE_ERROR(STAGE_DISCORD);
+      }
+      SCAN_STAGE(STAGE_DISCORD, discord_start);
+    }
 
     // Display denial feedback
+    SCAN_TIMER(result_oled_start);
     display.clearDisplay();
     display.drawBitmap(48, 16, denied[0], FRAME_WIDTH, FRAME_HEIGHT, 1);
     display.setTextSize(1);
     display.setTextColor(WHITE);
     display.setCursor(25, 50);
     display.print("Access Denied");
-    display.display();
+    display_show();
+    SCAN_STAGE(STAGE_OLED_RESULT, result_oled_start);
+
+    SCAN_TIMER(result_buzz_start);
     error_buzz(BUZZER_PIN);
+    SCAN_STAGE(STAGE_BUZZ_RESULT, result_buzz_start);
   }
-
-  // Reset MFRC522
-  mfrc522.PICC_HaltA();
-  delay(250);
+  SCAN_STAGE_US(STAGE_TOTAL, reader.last_detect_us + reader.last_read_us + (micros() - scan_start));
+  Serial.printf("Scan complete - UID: %s in %lu ms\n", uid, millis() - started_at);
+  return true;
 }
 
-void connect_wifi() {
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(wifi_ssid, wifi_pass);
+/**
+ * Apply a pushed roster change to the in-memory table at once
+ * Message: {"seq":N,"changes":[{"op":"upsert","uid":..,"dlsu_id":..,"name":..,"discord_username":..},
+ * {"op":"remove","uid":..}],"resync":false}; the next full download replaces the result either way
+ * "resync":true means changes were missed, so the whole roster is downloaded again
+ * @param payload Delta JSON
+ * @param length Payload length
+ */
+void apply_roster_delta(const char *payload, size_t length) {
+  JsonArenaLease arena;
+  JsonDocument doc(arena.allocator());
+  DeserializationError error = deserializeJson(doc, payload, length);
+  if (error) {
+    Serial.printf("Roster delta rejected: %s\n", error.c_str());
+    return;
+  }
+  if (doc["resync"] | false) {
+    if (!roster_sync_running) {
+      roster_sync_running = true;
+      xTaskCreatePinnedToCore(roster_resync_task, "roster_resync", 12288, nullptr, tskIDLE_PRIORITY + 1, nullptr, 0);
+    }
+    Serial.println("Roster delta asks for a full download");
+    return;
+  }
 
-  // Display connection status
-  display.setTextSize(1);
-  display.setTextColor(WHITE);
-  display.setCursor(0, 25);
-  display.print("Connecting to " + String(wifi_ssid));
+  uint16_t applied = 0;
+  xSemaphoreTake(roster_lock, portMAX_DELAY);
+  if (users == nullptr) {
+    // Nothing downloaded to patch (first boot, or the baked table); the sync brings the change
+    xSemaphoreGive(roster_lock);
+    Serial.println("Roster delta ignored until a roster is downloaded");
+    return;
+  }
+  for (JsonObject change : doc["changes"].as<JsonArray>()) {
+    const char *uid = change["uid"] | "";
+    const char *op = change["op"] | "";
+    if (*uid == '\0') {
+      continue;
+    }
+    int index = -1;
+    for (int i = 0; i < userCount; i++) {
+      if (users[i].uid == uid) {
+        index = i;
+        break;
+      }
+    }
+
+    if (strcmp(op, "remove") == 0) {
+      if (index >= 0) {
+        users[index] = users[userCount - 1];
+        userCount--;
+        applied++;
+      }
+      continue;
+    }
+    if (strcmp(op, "upsert") != 0) {
+      continue;
+    }
+    if (index < 0) {
+      UserInfo *grown = new UserInfo[userCount + 1];
+      for (int i = 0; i < userCount; i++) {
+        grown[i] = users[i];
+      }
+      delete[] users;
+      users = grown;
+      index = userCount++;
+    }
+    users[index].uid = uid;
+    users[index].dlsu_id = change["dlsu_id"] | "";
+    users[index].name = change["name"] | "";
+    users[index].discord_username = change["discord_username"] | "";
+    applied++;
+  }
+
+  gate_counters.roster_members = userCount;
+  xSemaphoreGive(roster_lock);
+  Serial.printf("Roster delta %u applied: %u changes, %d members\n", (unsigned)(doc["seq"] | 0), applied, userCount);
+}
+
+/**
+ * Push the frame buffer to the OLED (a blocking I2C transfer)
+ */
+void display_show() {
+  STALL_SCOPE("display");
   display.display();
+}
+
+/**
+ * Look a card up in the current roster
+ * The fields the scan path uses are copied into fixed buffers, so a roster swap
+ * cannot free them while the caller uses them and the lookup never allocates
+ * @param uid Formatted card UID
+ * @param member Receives the member on a match
+ * @return true if the card belongs to a member
+ */
+bool lookup_member(const char *uid, MemberCard &member) {
+  STALL_SCOPE("lookup");
+  bool found = false;
+  xSemaphoreTake(roster_lock, portMAX_DELAY);
+  for (int i = 0; i < userCount; i++) {
+    if (users[i].uid == uid) {
+      member_card_fill(member, users[i].dlsu_id.c_str(), users[i].name.c_str(), users[i].discord_username.c_str());
+      found = true;
+      break;
+    }
+  }
+#if USE_BAKED_ROSTER
+  // Until a sync installs a downloaded roster, the flash table answers
+  if (users == nullptr) {
+    const BakedMember *baked = baked_roster_find(uid);
+    if (baked != nullptr) {
+      member_card_fill(member, baked->dlsu_id, baked->name, baked->discord_username);
+      found = true;
+    }
+  }
+#endif
+  xSemaphoreGive(roster_lock);
+  return found;
+}
+
+// Wait between failed summary deliveries; only the backoff fields are used
+const RequestPolicy deny_summary_policy = {0, 0, 2000, 60000};
 
-  Serial.print("Connecting to WiFi network: " + String(wifi_ssid));
+/**
+ * Send the aggregated alert for one unknown card whose window closed with repeats
+ * Routed like the per-scan alerts: through Apps Script with server-side fan-out,
+ * from the gate otherwise or when the script did not post it
+ * At most one alert per call, from the idle branch of the loop; after a failed
+ * delivery the next try waits a growing backoff, and nothing is tried while the
+ * breakers of the routes it would take are open, so the readers keep being polled
+ */
+void flush_denied_repeats() {
+  static unsigned long last_attempt = 0;
+  static unsigned long retry_wait = 0;
+  static uint8_t failures = 0;
+  if (millis() - last_attempt < retry_wait) {
+    return;
+  }
+  uint32_t attempts = 0;
+  const char *uid = deny_cache_pending(attempts);
+  if (uid == nullptr) {
+    return;
+  }
+  bool via_script = device_config.server_notify && !breaker_blocking(apps_script_breaker);
+  bool via_discord = !breaker_blocking(discord_breaker);
+  if (!via_script && !via_discord) {
+    return;
+  }
 
-  // Wait for connection with timeout
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 30) {
-    delay(500);
-    Serial.print(".");
-    attempts++;
+  last_attempt = millis();
+  Serial.printf("Unknown card %s presented %u times, sending summary\n", uid, attempts);
+  bool notified = via_script && post_denied_repeat_alert(uid, attempts, DENY_WINDOW_MS / 1000);
+  if (notified || (via_discord && send_discord_embeds(denied_repeat_message(uid, attempts, DENY_WINDOW_MS / 1000)))) {
+    deny_cache_summarized(uid);
+    failures = 0;
+    retry_wait = 0;
+    return;
   }
+  failures = min(failures + 1, 8);
+  retry_wait = policy_backoff(deny_summary_policy, failures);
+  Serial.printf("Summary for %s not delivered, next try in %lu ms\n", uid, retry_wait);
+}
 
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.println("\nWiFi Connected Successfully");
-    Serial.println("IP Address: " + WiFi.localIP().toString());
-  } else {
-    Serial.println("\nWiFi Connection Failed");
+void console_stats(const char *args) {
+  console_printf("device %s (%s), server notify %s, cooldown %u ms\n", device_id(),
+                 device_config.label[0] ? device_config.label : "no label", device_config.server_notify ? "on" : "off",
+                 device_config.cooldown_ms);
+  console_printf("uptime %lu s, granted %u, denied %u, repeats suppressed %u\n", millis() / 1000,
+                 gate_counters.scans_granted, gate_counters.scans_denied, scan_guard_suppressed());
+  console_printf("unknown cards: %u tracked, %u alerts suppressed, %u summaries\n", deny_cache_size(),
+                 deny_stats.suppressed, deny_stats.summaries);
+  CircuitBreaker *breakers[] = {&apps_script_breaker, &discord_breaker};
+  for (CircuitBreaker *breaker : breakers) {
+    console_printf("breaker %s: %s, %u trips, %u ok, %u timeouts\n", breaker->name,
+                   breaker_state_names[breaker->state], breaker->trips, breaker->outcomes[REQUEST_OK],
+                   breaker->outcomes[REQUEST_TIMEOUT]);
   }
+  console_printf("clock: %s, %u syncs, last %lu s ago\n", clock_epoch_ms() != 0 ? "synced" : "not set",
+                 clock_stats.syncs, clock_stats.syncs > 0 ? (millis() - clock_stats.last_sync_ms) / 1000 : 0);
+  console_printf("wifi: %s, RSSI %d dBm, %u outages, %u reconnects, last reason %u\n",
+                 WiFi.status() == WL_CONNECTED ? "up" : "down", WiFi.RSSI(), wifi_stats.outages,
+                 wifi_stats.reconnects, wifi_stats.last_reason);
+#if MQTT_TRANSPORT
+  console_printf("mqtt: %s, %u connects, %u published, %u failed, %u deltas\n",
+                 mqtt_stats.connected ? "up" : "down", mqtt_stats.connects, mqtt_stats.published,
+                 mqtt_stats.publish_failures, mqtt_stats.deltas);
+#endif
 }
 
-bool check_uid(const String &target_uid) {
-  for (const String &uid : uid_db) {
-    if (uid == target_uid) {
-      return true;
+void console_roster(const char *args) {
+  const char *source = users != nullptr ? "downloaded" : (USE_BAKED_ROSTER && roster_ready ? "baked" : "none");
+  console_printf("roster: %s, %d members, version %08X\n", source, gate_counters.roster_members,
+                 gate_counters.roster_version);
+  console_printf("sync: %s, %u failed rounds\n", roster_sync_running ? "running" : "idle", roster_sync_failures);
+}
+
+void console_lookup(const char *args) {
+  if (*args == '\0') {
+    console_printf("usage: lookup <uid>\n");
+    return;
+  }
+  MemberCard member;
+  if (!lookup_member(args, member)) {
+    console_printf("%s: not in roster\n", args);
+    return;
+  }
+  console_printf("%s: %s, %s, @%s\n", args, member.name, member.dlsu_id, member.discord_username);
+}
+
+void console_sync(const char *args) {
+  if (roster_sync_running) {
+    console_printf("sync: already running\n");
+    return;
+  }
+  roster_sync_running = true;
+  xTaskCreatePinnedToCore(roster_resync_task, "roster_resync", 12288, nullptr, tskIDLE_PRIORITY + 1, nullptr, 0);
+  console_printf("sync: started\n");
+}
+
+void console_queue(const char *args) {
+  console_printf("outbox: %u of %u slots, %u dropped\n", scan_outbox_count, SCAN_OUTBOX_SLOTS, scan_outbox_dropped);
+  for (uint8_t i = 0; i < scan_outbox_count; i++) {
+    const PendingScan &scan = scan_outbox[(scan_outbox_head + i) % SCAN_OUTBOX_SLOTS];
+    console_printf("  #%u %s reader %u %s\n", scan.event_seq, scan.uid, scan.reader_id,
+                   scan.access_granted ? "granted" : "denied");
+  }
+}
+
+void console_heap(const char *args) {
+  HeapSnapshot snapshot = heap_snapshot();
+  console_printf("heap: free %u, min free %u, largest block %u (low %u, baseline %u, %u drops)\n",
+                 snapshot.free_bytes, snapshot.min_free_bytes, snapshot.largest_block, heap_largest_block_low,
+                 heap_largest_block_baseline, heap_largest_block_drops);
+  console_printf("json arena: %u bytes in %s, last parse %u, peak %u, %u parses, %u spilled, %u resizes\n",
+                 json_arena_stats.capacity, json_arena_stats.psram ? "PSRAM" : "RAM", json_arena_stats.last_peak,
+                 json_arena_stats.peak, json_arena_stats.parses, json_arena_stats.spills, json_arena_stats.resizes);
+}
+
+#if STALL_MONITOR
+void console_stalls(const char *args) {
+  StallRecord worst[STALL_WORST];
+  uint8_t count = stall_worst_sorted(worst);
+  console_printf("stalls: %u flagged, worst %u:\n", stall_count, count);
+  for (uint8_t i = 0; i < count; i++) {
+    console_printf("  %5u ms %s (line %u) on %s, %lu s ago\n", worst[i].duration_ms, worst[i].site, worst[i].line,
+                   worst[i].task, (millis() - worst[i].at_ms) / 1000);
+  }
+  for (uint8_t i = 0; i < STALL_SITES && stall_sites[i].name != nullptr; i++) {
+    const StallSite &site = stall_sites[i];
+    console_printf("  %-16s %6u calls, avg %lu us, max %u us, %u stalls\n", site.name, site.calls,
+                   (unsigned long)(site.total_us / max(site.calls, (uint32_t)1)), site.max_us, site.stalls);
+  }
+  if (stall_last_reset.magic != 0) {
+    console_printf("last watchdog reset in %s (line %u)\n", stall_last_reset.site, stall_last_reset.line);
+  }
+}
+#endif
+
+#if SCAN_INJECT
+/**
+ * Replayed scan from tools/scan_replay.py: "scan <reader_id> <uid with spaces>"
+ * Progress is logged on Serial directly, where the replayer looks for it
+ */
+void console_scan(const char *args) {
+  char *rest = nullptr;
+  long id = strtol(args, &rest, 10);
+  if (rest == args || *rest != ' ' || id < 0 || id > 255) {
+    console_printf("usage: scan <reader_id> <uid>\n");
+    return;
+  }
+  char uid[UID_TEXT_SIZE];
+  strncpy(uid, rest + 1, sizeof(uid) - 1);
+  uid[sizeof(uid) - 1] = '\0';
+
+  for (size_t i = 0; i < readerCount; i++) {
+    if (readers[i].id == id) {
+      Serial.printf("Scan injected - UID: %s (reader %ld)\n", uid, id);
+      readers[i].last_detect_us = 0;
+      readers[i].last_read_us = 0;
+      process_scan(readers[i], uid);
+      return;
     }
   }
-  return false;
-}
\ No newline at end of file
+  console_printf("scan: no reader %ld\n", id);
+}
+#endif
@@ -0,0 +1,341 @@
+/**
+ * On-Device Metrics Server
+ * Serves Prometheus text metrics and a short status page over HTTP
+ * Runs in its own low-priority task on the protocol core, away from the scan loop
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WebServer.h>
+#include <apps_script_client.h>
+#include <boot_timeline.h>
+#include <clock_sync.h>
+#include <deny_cache.h>
+#include <heap_telemetry.h>
+#include <json_arena.h>
+#include <http_policy.h>
+#include <mqtt_transport.h>
+#include <readers.h>
+#include <scan_guard.h>
+#include <scan_metrics.h>
+#include <scan_outbox.h>
+#include <stall_monitor.h>
+#include <tls_session.h>
+#include <wifi_link.h>
+
+#ifndef METRICS_PORT
+#define METRICS_PORT 80
+#endif
+
+// The exposition is streamed as chunked transfer encoding, one buffer at a time
+#ifndef METRICS_CHUNK_SIZE
+#define METRICS_CHUNK_SIZE 1024
+#endif
+
+// Counters owned by the scan loop, read by the server task
+struct GateCounters {
+  volatile uint32_t scans_granted;
+  volatile uint32_t scans_denied;
+  volatile uint32_t roster_version;
+  volatile int32_t roster_members;
+};
+
+static GateCounters gate_counters = {0, 0, 0, 0};
+
+static WebServer metrics_http(METRICS_PORT);
+static CardReader *metrics_readers = nullptr;
+static size_t metrics_reader_count = 0;
+static char metrics_buffer[METRICS_CHUNK_SIZE];
+static size_t metrics_length = 0;
+
+// Lines cut short because a single line did not fit in a chunk
+static uint32_t metrics_truncated = 0;
+
+/**
+ * Send the buffered text as one chunk of the response
+ */
+void metrics_flush() {
+  if (metrics_length > 0) {
+    metrics_http.sendContent(metrics_buffer, metrics_length);
+    metrics_length = 0;
+  }
+}
+
+/**
+ * Append formatted text to the metrics response, sending the buffer as a chunk when it fills up
+ * Text longer than a whole chunk is cut short and counted in metrics_truncated
+ */
+void metrics_printf(const char *format, ...) {
+  va_list args;
+  for (int pass = 0; pass < 2; pass++) {
+    size_t room = sizeof(metrics_buffer) - metrics_length;
+    va_start(args, format);
+    int written = vsnprintf(metrics_buffer + metrics_length, room, format, args);
+    va_end(args);
+
+    if (written < 0) {
+      return;
+    }
+    if ((size_t)written < room) {
+      metrics_length += written;
+      return;
+    }
+    if (metrics_length == 0) {
+      break;
+    }
+    // Did not fit behind the buffered text: send that, then format again into the empty buffer
+    metrics_flush();
+  }
+
+  metrics_length = sizeof(metrics_buffer) - 1;
+  metrics_buffer[metrics_length - 1] = '\n';
+  metrics_truncated++;
+  Serial.printf("Metrics line longer than %u bytes cut short\n", sizeof(metrics_buffer));
+  metrics_flush();
+}
+
+/**
+ * Write HELP and TYPE lines for a metric family
+ */
+void metrics_header(const char *name, const char *type, const char *help) {
+  metrics_printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/**
+ * Write the Prometheus exposition text to the response through metrics_printf()
+ */
+void metrics_build() {
+  metrics_header("gate_scans_total", "counter", "Card scans by result");
+  metrics_printf("gate_scans_total{result=\"granted\"} %u\n", gate_counters.scans_granted);
+  metrics_printf("gate_scans_total{result=\"denied\"} %u\n", gate_counters.scans_denied);
+  metrics_printf("gate_scans_total{result=\"suppressed\"} %u\n", scan_guard_suppressed());
+
+  metrics_header("gate_reader_polls_total", "counter", "Detection polls or IRQ arms per reader");
+  for (size_t i = 0; i < metrics_reader_count; i++) {
+    metrics_printf("gate_reader_polls_total{reader=\"%u\",label=\"%s\"} %u\n",
+                   metrics_readers[i].id, metrics_readers[i].label, metrics_readers[i].polls);
+  }
+  metrics_header("gate_reader_scans_total", "counter", "Cards detected per reader");
+  for (size_t i = 0; i < metrics_reader_count; i++) {
+    metrics_printf("gate_reader_scans_total{reader=\"%u\",label=\"%s\"} %u\n",
+                   metrics_readers[i].id, metrics_readers[i].label, metrics_readers[i].scans);
+  }
+  metrics_header("gate_reader_present", "gauge", "Whether the reader answered at boot");
+  for (size_t i = 0; i < metrics_reader_count; i++) {
+    metrics_printf("gate_reader_present{reader=\"%u\",label=\"%s\"} %d\n",
+                   metrics_readers[i].id, metrics_readers[i].label, metrics_readers[i].present ? 1 : 0);
+  }
+
+#if SCAN_METRICS
+  metrics_header("gate_stage_latency_seconds", "summary", "Scan path stage latency");
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    const StageHistogram &hist = stage_histograms[i];
+    const uint8_t quantiles[] = {50, 95, 99};
+    for (uint8_t q : quantiles) {
+      metrics_printf("gate_stage_latency_seconds{stage=\"%s\",quantile=\"0.%02u\"} %.6f\n",
+                     stage_names[i], q, scan_metrics_percentile(hist, q) / 1e6);
+    }
+    metrics_printf("gate_stage_latency_seconds_sum{stage=\"%s\"} %.6f\n", stage_names[i], hist.total_us / 1e6);
+    metrics_printf("gate_stage_latency_seconds_count{stage=\"%s\"} %u\n", stage_names[i], hist.count);
+  }
+  metrics_header("gate_stage_errors_total", "counter", "Failed scan path stages");
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    metrics_printf("gate_stage_errors_total{stage=\"%s\"} %u\n", stage_names[i], stage_histograms[i].errors);
+  }
+#endif
+
+  metrics_header("gate_denied_repeats_suppressed_total", "counter", "Repeat denials handled locally");
+  metrics_printf("gate_denied_repeats_suppressed_total %u\n", deny_stats.suppressed);
+  metrics_header("gate_denied_repeat_alerts_total", "counter", "Aggregated repeat-denial alerts sent");
+  metrics_printf("gate_denied_repeat_alerts_total %u\n", deny_stats.summaries);
+  metrics_header("gate_denied_repeats_unreported_total", "counter", "Repeat windows lost before their alert was sent");
+  metrics_printf("gate_denied_repeats_unreported_total %u\n", deny_stats.evicted_pending);
+  metrics_header("gate_denied_cards_tracked", "gauge", "Unknown cards in the denial cache");
+  metrics_printf("gate_denied_cards_tracked %u\n", deny_cache_size());
+
+  metrics_header("gate_outbox_depth", "gauge", "Attendance records waiting for delivery");
+  metrics_printf("gate_outbox_depth %u\n", scan_outbox_count);
+  metrics_header("gate_outbox_dropped_total", "counter", "Attendance records dropped from a full outbox");
+  metrics_printf("gate_outbox_dropped_total %u\n", scan_outbox_dropped);
+
+  CircuitBreaker *breakers[] = {&apps_script_breaker, &discord_breaker};
+  metrics_header("gate_breaker_state", "gauge", "Endpoint circuit breaker state (0 closed, 1 open, 2 half-open)");
+  for (CircuitBreaker *breaker : breakers) {
+    metrics_printf("gate_breaker_state{endpoint=\"%s\"} %u\n", breaker->name, breaker->state);
+  }
+  metrics_header("gate_breaker_trips_total", "counter", "Times the endpoint breaker opened");
+  for (CircuitBreaker *breaker : breakers) {
+    metrics_printf("gate_breaker_trips_total{endpoint=\"%s\"} %u\n", breaker->name, breaker->trips);
+  }
+  metrics_header("gate_requests_total", "counter", "Outbound request attempts by outcome");
+  for (CircuitBreaker *breaker : breakers) {
+    for (uint8_t i = 0; i < REQUEST_OUTCOME_COUNT; i++) {
+      metrics_printf("gate_requests_total{endpoint=\"%s\",outcome=\"%s\"} %u\n",
+                     breaker->name, request_outcome_names[i], breaker->outcomes[i]);
+    }
+  }
+
+  metrics_header("gate_apps_script_requests_total", "counter", "Logical Apps Script requests");
+  metrics_printf("gate_apps_script_requests_total %u\n", apps_script_trips.requests);
+  metrics_header("gate_apps_script_round_trips_total", "counter", "HTTP exchanges made for Apps Script requests");
+  metrics_printf("gate_apps_script_round_trips_total %u\n", apps_script_trips.round_trips);
+  metrics_header("gate_apps_script_connects_total", "counter", "New connections opened to Apps Script hosts");
+  metrics_printf("gate_apps_script_connects_total %u\n", apps_script_trips.connects);
+
+  metrics_header("gate_tls_handshakes_total", "counter", "TLS handshakes by host and kind");
+  for (TlsSessionClient *client : tls_clients) {
+    for (uint8_t i = 0; client != nullptr && i < TLS_HANDSHAKE_KIND_COUNT; i++) {
+      metrics_printf("gate_tls_handshakes_total{host=\"%s\",kind=\"%s\"} %u\n",
+                     client->name, tls_handshake_names[i], client->handshakes[i]);
+    }
+  }
+  metrics_header("gate_tls_handshake_seconds_sum", "counter", "Time spent in TLS handshakes by host and kind");
+  for (TlsSessionClient *client : tls_clients) {
+    for (uint8_t i = 0; client != nullptr && i < TLS_HANDSHAKE_KIND_COUNT; i++) {
+      metrics_printf("gate_tls_handshake_seconds_sum{host=\"%s\",kind=\"%s\"} %.6f\n",
+                     client->name, tls_handshake_names[i], client->handshake_us[i] / 1e6);
+    }
+  }
+
+  metrics_header("gate_heap_free_bytes", "gauge", "Free heap");
+  metrics_printf("gate_heap_free_bytes %u\n", ESP.getFreeHeap());
+  metrics_header("gate_heap_min_free_bytes", "gauge", "Lowest free heap since boot");
+  metrics_printf("gate_heap_min_free_bytes %u\n", ESP.getMinFreeHeap());
+  metrics_header("gate_heap_largest_free_block_bytes", "gauge", "Largest allocatable heap block");
+  metrics_printf("gate_heap_largest_free_block_bytes %u\n", ESP.getMaxAllocHeap());
+  metrics_header("gate_heap_largest_free_block_low_bytes", "gauge", "Lowest largest free block seen by heap telemetry");
+  metrics_printf("gate_heap_largest_free_block_low_bytes %u\n", heap_largest_block_low);
+  metrics_header("gate_json_arena_bytes", "gauge", "JSON arena block size");
+  metrics_printf("gate_json_arena_bytes %u\n", json_arena_stats.capacity);
+  metrics_header("gate_json_arena_peak_bytes", "gauge", "Most arena memory a JSON parse has used");
+  metrics_printf("gate_json_arena_peak_bytes{parse=\"last\"} %u\n", json_arena_stats.last_peak);
+  metrics_printf("gate_json_arena_peak_bytes{parse=\"max\"} %u\n", json_arena_stats.peak);
+  metrics_header("gate_json_arena_spills_total", "counter", "JSON parses that outgrew the arena and used the heap");
+  metrics_printf("gate_json_arena_spills_total %u\n", json_arena_stats.spills);
+
+  metrics_header("gate_wifi_rssi_dbm", "gauge", "WiFi signal strength");
+  metrics_printf("gate_wifi_rssi_dbm %d\n", WiFi.RSSI());
+  metrics_header("gate_wifi_outages_total", "counter", "WiFi link drops");
+  metrics_printf("gate_wifi_outages_total %u\n", wifi_stats.outages);
+  metrics_header("gate_wifi_outage_seconds_total", "counter", "Time spent without a WiFi link");
+  metrics_printf("gate_wifi_outage_seconds_total %.3f\n", wifi_stats.outage_total_ms / 1e3);
+  metrics_header("gate_wifi_last_outage_seconds", "gauge", "Length of the last WiFi outage");
+  metrics_printf("gate_wifi_last_outage_seconds %.3f\n", wifi_stats.last_outage_ms / 1e3);
+  metrics_header("gate_wifi_last_connect_seconds", "gauge", "Association plus DHCP time of the last connect");
+  metrics_printf("gate_wifi_last_connect_seconds %.3f\n", wifi_stats.last_connect_ms / 1e3);
+  metrics_header("gate_wifi_reconnects_total", "counter", "Background reconnects after a drop");
+  metrics_printf("gate_wifi_reconnects_total %u\n", wifi_stats.reconnects);
+  metrics_header("gate_wifi_fast_connects_total", "counter", "Connects that used the cached AP");
+  metrics_printf("gate_wifi_fast_connects_total %u\n", wifi_stats.fast_connects);
+  metrics_header("gate_wifi_last_disconnect_reason", "gauge", "802.11 reason code of the last drop");
+  metrics_printf("gate_wifi_last_disconnect_reason %u\n", wifi_stats.last_reason);
+
+#if MQTT_TRANSPORT
+  metrics_header("gate_mqtt_connected", "gauge", "Whether the broker session is up");
+  metrics_printf("gate_mqtt_connected %u\n", mqtt_stats.connected ? 1 : 0);
+  metrics_header("gate_mqtt_connects_total", "counter", "Broker sessions opened");
+  metrics_printf("gate_mqtt_connects_total %u\n", mqtt_stats.connects);
+  metrics_header("gate_mqtt_published_total", "counter", "Scan events acknowledged by the broker");
+  metrics_printf("gate_mqtt_published_total %u\n", mqtt_stats.published);
+  metrics_header("gate_mqtt_publish_failures_total", "counter", "Publishes without a PUBACK");
+  metrics_printf("gate_mqtt_publish_failures_total %u\n", mqtt_stats.publish_failures);
+  metrics_header("gate_mqtt_queue_full_total", "counter", "Scan events sent over HTTP because the MQTT queue was full");
+  metrics_printf("gate_mqtt_queue_full_total %u\n", mqtt_stats.queue_full);
+  metrics_header("gate_mqtt_roster_deltas_total", "counter", "Roster delta messages received");
+  metrics_printf("gate_mqtt_roster_deltas_total %u\n", mqtt_stats.deltas);
+
+#endif
+#if STALL_MONITOR
+  metrics_header("gate_stalls_total", "counter", "Timed calls that ran past their limit");
+  metrics_printf("gate_stalls_total %u\n", stall_count);
+  metrics_header("gate_call_seconds_sum", "counter", "Time spent in each timed call site");
+  for (uint8_t i = 0; i < STALL_SITES && stall_sites[i].name != nullptr; i++) {
+    metrics_printf("gate_call_seconds_sum{site=\"%s\"} %.3f\n", stall_sites[i].name, stall_sites[i].total_us / 1e6);
+  }
+  metrics_header("gate_call_seconds_count", "counter", "Calls per timed call site");
+  for (uint8_t i = 0; i < STALL_SITES && stall_sites[i].name != nullptr; i++) {
+    metrics_printf("gate_call_seconds_count{site=\"%s\"} %u\n", stall_sites[i].name, stall_sites[i].calls);
+  }
+  metrics_header("gate_call_max_seconds", "gauge", "Longest call per timed call site");
+  for (uint8_t i = 0; i < STALL_SITES && stall_sites[i].name != nullptr; i++) {
+    metrics_printf("gate_call_max_seconds{site=\"%s\"} %.3f\n", stall_sites[i].name, stall_sites[i].max_us / 1e6);
+  }
+
+#endif
+  metrics_header("gate_boot_phase_seconds", "gauge", "Time since reset at which each boot phase finished");
+  for (uint8_t i = 0; i < BOOT_PHASE_COUNT; i++) {
+    if (boot_phase_ms[i] != 0) {
+      metrics_printf("gate_boot_phase_seconds{phase=\"%s\"} %.3f\n", boot_phase_names[i], boot_phase_ms[i] / 1e3);
+    }
+  }
+
+  metrics_header("gate_clock_syncs_total", "counter", "Successful SNTP syncs");
+  metrics_printf("gate_clock_syncs_total %u\n", clock_stats.syncs);
+  metrics_header("gate_clock_synced", "gauge", "1 once the UTC clock is set");
+  metrics_printf("gate_clock_synced %d\n", clock_epoch_ms() != 0 ? 1 : 0);
+
+  metrics_header("gate_uptime_seconds", "counter", "Time since boot");
+  metrics_printf("gate_uptime_seconds %lu\n", millis() / 1000);
+
+  metrics_header("gate_roster_version", "gauge", "Hash of the loaded roster");
+  metrics_printf("gate_roster_version %u\n", gate_counters.roster_version);
+  metrics_header("gate_roster_members", "gauge", "Members in the loaded roster");
+  metrics_printf("gate_roster_members %d\n", gate_counters.roster_members);
+
+  metrics_header("gate_metrics_truncated_total", "counter", "Metrics lines cut short to fit a response chunk");
+  metrics_printf("gate_metrics_truncated_total %u\n", metrics_truncated);
+}
+
+/**
+ * GET /metrics - Prometheus text exposition
+ */
+void metrics_handle_metrics() {
+  metrics_http.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  metrics_http.send(200, "text/plain; version=0.0.4", "");
+  metrics_length = 0;
+  metrics_build();
+  metrics_flush();
+  // Empty chunk ends the response
+  metrics_http.sendContent("");
+}
+
+/**
+ * GET /status - one-line human readable summary
+ */
+void metrics_handle_status() {
+  char status[128];
+  snprintf(status, sizeof(status), "uptime=%lus granted=%u denied=%u roster=%d version=%08x rssi=%d heap=%u\n",
+           millis() / 1000, gate_counters.scans_granted, gate_counters.scans_denied,
+           gate_counters.roster_members, gate_counters.roster_version, WiFi.RSSI(), ESP.getFreeHeap());
+  metrics_http.send(200, "text/plain", status);
+}
+
+/**
+ * Server task body - services clients without ever touching the scan loop
+ */
+void metrics_server_task(void *arg) {
+  metrics_http.on("/metrics", HTTP_GET, metrics_handle_metrics);
+  metrics_http.on("/status", HTTP_GET, metrics_handle_status);
+  metrics_http.begin();
+  Serial.println("Metrics server listening on port " + String(METRICS_PORT));
+
+  while (true) {
+    metrics_http.handleClient();
+    vTaskDelay(pdMS_TO_TICKS(20));
+  }
+}
+
+/**
+ * Start the metrics server task
+ * @param readers Reader table to report on
+ * @param count Number of readers in the table
+ */
+void metrics_server_begin(CardReader *readers, size_t count) {
+  metrics_readers = readers;
+  metrics_reader_count = count;
+
+  // Lowest non-idle priority, pinned to the core that runs the WiFi stack
+  xTaskCreatePinnedToCore(metrics_server_task, "metrics", 4096, nullptr, tskIDLE_PRIORITY + 1, nullptr, 0);
+}
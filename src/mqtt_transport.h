@@ -0,0 +1,187 @@
+/**
+ * MQTT Transport
+ * One persistent broker connection for scan events and pushed roster changes
+ *
+ * Enabled with -D MQTT_TRANSPORT=1 and MQTT_HOST (plus optional MQTT_PORT,
+ * MQTT_USER, MQTT_PASS) in secrets.h. Topics, under MQTT_TOPIC_PREFIX:
+ * - <prefix>/<client id>/scan    scan events, QoS 1 (the attendance payload)
+ * - <prefix>/<client id>/status  "online", or "offline" as the retained will
+ * - <prefix>/roster/delta        roster changes pushed to every gate, QoS 1
+ * tools/mqtt_sheets_bridge.py forwards scans to doPost and publishes the
+ * changes doGet ?changes reports. The connection runs on its own task; the
+ * scan loop only queues events, and an event leaves the queue after PUBACK.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <MQTT.h>
+#include <WiFi.h>
+#include <device_config.h>
+#include <http_policy.h>
+#include <secrets.h>
+
+#ifndef MQTT_TRANSPORT
+#define MQTT_TRANSPORT 0
+#endif
+
+#if MQTT_TRANSPORT
+
+#ifndef MQTT_HOST
+#error "MQTT_TRANSPORT needs MQTT_HOST in secrets.h"
+#endif
+
+#ifndef MQTT_PORT
+#define MQTT_PORT 1883
+#endif
+
+#ifndef MQTT_TOPIC_PREFIX
+#define MQTT_TOPIC_PREFIX "gate"
+#endif
+
+// Largest message in either direction; roster deltas are the big ones
+#ifndef MQTT_BUFFER_SIZE
+#define MQTT_BUFFER_SIZE 2048
+#endif
+
+#define MQTT_QUEUE_DEPTH 16
+#define MQTT_EVENT_SIZE 256
+#define MQTT_KEEPALIVE_S 30
+#define MQTT_POLL_MS 50
+
+// Reconnect backoff; only the backoff fields are used
+const RequestPolicy mqtt_policy = {0, 0, 1000, 30000};
+
+// Connection and delivery counters, read by the metrics server and console
+struct MqttStats {
+  volatile bool connected;
+  volatile uint32_t connects;
+  volatile uint32_t published;
+  volatile uint32_t publish_failures;
+  volatile uint32_t queue_full;
+  volatile uint32_t deltas;
+};
+
+static MqttStats mqtt_stats = {false, 0, 0, 0, 0, 0};
+static WiFiClient mqtt_net;
+static MQTTClient mqtt_client(MQTT_BUFFER_SIZE);
+static QueueHandle_t mqtt_events = nullptr;
+static const char *mqtt_client_id = nullptr;
+static char mqtt_scan_topic[64];
+static char mqtt_status_topic[64];
+static void (*mqtt_delta_handler)(const char *payload, size_t length) = nullptr;
+
+/**
+ * Broker message callback, runs inside mqtt_client.loop() on the MQTT task
+ */
+void mqtt_on_message(MQTTClient *client, char topic[], char bytes[], int length) {
+  if (strcmp(topic, MQTT_TOPIC_PREFIX "/roster/delta") == 0 && mqtt_delta_handler != nullptr) {
+    mqtt_stats.deltas++;
+    mqtt_delta_handler(bytes, length);
+  }
+}
+
+/**
+ * Open the session: persistent, so QoS 1 deltas sent while the gate was away are delivered
+ * @return true once connected and subscribed
+ */
+bool mqtt_connect() {
+  mqtt_client.setWill(mqtt_status_topic, "offline", true, 1);
+#if defined(MQTT_USER) && defined(MQTT_PASS)
+  bool connected = mqtt_client.connect(mqtt_client_id, MQTT_USER, MQTT_PASS);
+#else
+  bool connected = mqtt_client.connect(mqtt_client_id);
+#endif
+  if (!connected) {
+    Serial.printf("MQTT connect to %s:%u failed (%d, return code %d)\n", MQTT_HOST, MQTT_PORT,
+                  mqtt_client.lastError(), mqtt_client.returnCode());
+    return false;
+  }
+  mqtt_client.subscribe(MQTT_TOPIC_PREFIX "/roster/delta", 1);
+  mqtt_client.publish(mqtt_status_topic, "online", true, 1);
+  mqtt_stats.connects++;
+  Serial.printf("MQTT connected to %s:%u as %s\n", MQTT_HOST, MQTT_PORT, mqtt_client_id);
+  return true;
+}
+
+/**
+ * Connection task: keeps the session up, services incoming messages and
+ * publishes queued scan events in order
+ */
+void mqtt_task(void *arg) {
+  char event[MQTT_EVENT_SIZE];
+  uint8_t attempt = 0;
+
+  while (true) {
+    if (!mqtt_client.connected()) {
+      mqtt_stats.connected = false;
+      if (WiFi.status() != WL_CONNECTED) {
+        vTaskDelay(pdMS_TO_TICKS(500));
+        continue;
+      }
+      if (!mqtt_connect()) {
+        attempt = min(attempt + 1, 8);
+        vTaskDelay(pdMS_TO_TICKS(policy_backoff(mqtt_policy, attempt)));
+        continue;
+      }
+      attempt = 0;
+      mqtt_stats.connected = true;
+    }
+
+    mqtt_client.loop();
+
+    // Waiting on the queue doubles as the loop interval
+    if (xQueuePeek(mqtt_events, event, pdMS_TO_TICKS(MQTT_POLL_MS)) == pdTRUE) {
+      if (mqtt_client.publish(mqtt_scan_topic, event, strlen(event), false, 1)) {
+        xQueueReceive(mqtt_events, event, 0);
+        mqtt_stats.published++;
+      } else {
+        // Kept at the head of the queue and sent again after the reconnect
+        mqtt_stats.publish_failures++;
+        Serial.printf("MQTT publish failed (%d), reconnecting\n", mqtt_client.lastError());
+        mqtt_client.disconnect();
+      }
+    }
+  }
+}
+
+/**
+ * Queue a scan event for publishing; never waits
+ * @param payload Attendance JSON, the same body doPost takes
+ * @return false if the broker is not connected or the queue is full (the caller uses HTTP instead)
+ */
+bool mqtt_publish_scan(const char *payload) {
+  if (mqtt_events == nullptr || !mqtt_stats.connected) {
+    return false;
+  }
+  char event[MQTT_EVENT_SIZE];
+  strncpy(event, payload, sizeof(event) - 1);
+  event[sizeof(event) - 1] = '\0';
+  if (xQueueSend(mqtt_events, event, 0) != pdTRUE) {
+    mqtt_stats.queue_full++;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Start the MQTT task; the client id is the device ID
+ * @param on_delta Called on the MQTT task with each roster delta message
+ */
+void mqtt_begin(void (*on_delta)(const char *payload, size_t length)) {
+  mqtt_client_id = device_id();
+  snprintf(mqtt_scan_topic, sizeof(mqtt_scan_topic), MQTT_TOPIC_PREFIX "/%s/scan", mqtt_client_id);
+  snprintf(mqtt_status_topic, sizeof(mqtt_status_topic), MQTT_TOPIC_PREFIX "/%s/status", mqtt_client_id);
+  mqtt_delta_handler = on_delta;
+
+  mqtt_client.begin(MQTT_HOST, MQTT_PORT, mqtt_net);
+  mqtt_client.setKeepAlive(MQTT_KEEPALIVE_S);
+  mqtt_client.setCleanSession(false);
+  mqtt_client.setTimeout(2000);
+  mqtt_client.onMessageAdvanced(mqtt_on_message);
+
+  mqtt_events = xQueueCreate(MQTT_QUEUE_DEPTH, MQTT_EVENT_SIZE);
+  xTaskCreatePinnedToCore(mqtt_task, "mqtt", 6144, nullptr, tskIDLE_PRIORITY + 1, nullptr, 0);
+}
+
+#endif
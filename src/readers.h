@@ -0,0 +1,275 @@
+/**
+ * RFID Reader Management
+ * Drives several MFRC522 readers sharing one SPI bus and reset line
+ * Readers with an IRQ line wired are armed for receive interrupts instead of polled
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <MFRC522.h>
+#include <uid_format.h>
+
+// Interval between per-reader metric reports on Serial
+#ifndef READER_REPORT_INTERVAL_MS
+#define READER_REPORT_INTERVAL_MS 60000
+#endif
+
+// Use the MFRC522 IRQ line for card detection where a pin is configured
+#ifndef READER_USE_IRQ
+#define READER_USE_IRQ 0
+#endif
+
+// How often an idle IRQ reader re-sends REQA to look for a card
+#ifndef READER_IRQ_REARM_MS
+#define READER_IRQ_REARM_MS 100
+#endif
+
+// Individual reader on the shared bus
+struct CardReader {
+  uint8_t id;
+  const char *label;
+  MFRC522 rfid;
+  byte ss_pin;
+  int8_t irq_pin;
+  bool present;
+
+  // Interrupt state
+  volatile bool irq_fired;
+  volatile uint32_t irq_at_us;
+  unsigned long armed_at;
+
+  // Per-reader metrics
+  uint32_t polls;
+  uint32_t scans;
+  unsigned long last_poll_at;
+  unsigned long max_poll_gap_ms;
+  uint64_t bus_busy_us;
+  uint64_t detect_latency_sum_us;
+  uint32_t detect_latency_max_us;
+
+  // Timings of the most recent detection, for the scan stage metrics
+  uint32_t last_detect_us;
+  uint32_t last_read_us;
+
+  CardReader(uint8_t reader_id, const char *reader_label, byte select_pin, byte rst_pin, int8_t irq = -1)
+      : id(reader_id), label(reader_label), rfid(select_pin, rst_pin), ss_pin(select_pin), irq_pin(irq),
+        present(false), irq_fired(false), irq_at_us(0), armed_at(0),
+        polls(0), scans(0), last_poll_at(0), max_poll_gap_ms(0),
+        bus_busy_us(0), detect_latency_sum_us(0), detect_latency_max_us(0),
+        last_detect_us(0), last_read_us(0) {}
+
+  bool uses_irq() const { return READER_USE_IRQ && irq_pin >= 0; }
+};
+
+static TaskHandle_t reader_wait_task = nullptr;
+static uint64_t reader_idle_us = 0;
+
+/**
+ * IRQ line handler - records the arrival time and wakes the main loop
+ * @param arg Reader that raised the interrupt
+ */
+void IRAM_ATTR reader_irq_handler(void *arg) {
+  CardReader *reader = (CardReader *)arg;
+  reader->irq_at_us = micros();
+  reader->irq_fired = true;
+
+  BaseType_t woken = pdFALSE;
+  if (reader_wait_task != nullptr) {
+    vTaskNotifyGiveFromISR(reader_wait_task, &woken);
+  }
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+/**
+ * Send a single REQA and let the receive interrupt report any answer
+ * @param reader Reader to arm
+ */
+void reader_arm(CardReader &reader) {
+  uint32_t start = micros();
+  MFRC522 &rfid = reader.rfid;
+
+  rfid.PCD_WriteRegister(MFRC522::ComIrqReg, 0x7F);       // Clear pending interrupt bits
+  rfid.PCD_WriteRegister(MFRC522::FIFOLevelReg, 0x80);    // Flush FIFO
+  rfid.PCD_WriteRegister(MFRC522::FIFODataReg, MFRC522::PICC_CMD_REQA);
+  rfid.PCD_WriteRegister(MFRC522::CommandReg, MFRC522::PCD_Transceive);
+  rfid.PCD_WriteRegister(MFRC522::BitFramingReg, 0x87);   // StartSend, 7-bit short frame
+
+  reader.armed_at = millis();
+  reader.bus_busy_us += micros() - start;
+}
+
+/**
+ * Initialize every reader and mark the ones that answer on the bus
+ * Readers share the reset line, so a single hard reset covers all of them
+ * @param readers Reader table
+ * @param count Number of readers in the table
+ */
+void readers_init(CardReader *readers, size_t count) {
+  reader_wait_task = xTaskGetCurrentTaskHandle();
+
+  // Deselect every reader first: an unconfigured chip-select can float low and
+  // answer on MISO while another reader is being probed
+  for (size_t i = 0; i < count; i++) {
+    pinMode(readers[i].ss_pin, OUTPUT);
+    digitalWrite(readers[i].ss_pin, HIGH);
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    CardReader &reader = readers[i];
+    reader.rfid.PCD_Init();
+
+    // Missing readers float the bus and read back 0x00 or 0xFF
+    byte version = reader.rfid.PCD_ReadRegister(MFRC522::VersionReg);
+    reader.present = (version != 0x00 && version != 0xFF);
+
+    Serial.println("Reader " + String(reader.id) + " (" + reader.label + "): " +
+                   (reader.present ? "firmware 0x" + String(version, HEX) : String("not detected")) +
+                   (reader.uses_irq() ? ", IRQ on GPIO " + String(reader.irq_pin) : String(", polling")));
+
+    if (reader.present && reader.uses_irq()) {
+      // IRQ pin active low, raised only on receive
+      reader.rfid.PCD_WriteRegister(MFRC522::ComIEnReg, 0xA0);
+      pinMode(reader.irq_pin, INPUT_PULLUP);
+      attachInterruptArg(digitalPinToInterrupt(reader.irq_pin), reader_irq_handler, &reader, FALLING);
+      reader_arm(reader);
+    }
+  }
+}
+
+/**
+ * Check the readers round-robin for a new card
+ * Polled readers run a full REQA exchange; IRQ readers only check their flag
+ * and are re-armed when idle. Every present reader is visited once per call,
+ * starting after the reader that last produced a card so none can starve.
+ * @param readers Reader table
+ * @param count Number of readers in the table
+ * @return Reader holding a freshly selected card, or nullptr if none
+ */
+CardReader *readers_poll(CardReader *readers, size_t count) {
+  static size_t next_reader = 0;
+  unsigned long now = millis();
+
+  for (size_t n = 0; n < count; n++) {
+    size_t index = (next_reader + n) % count;
+    CardReader &reader = readers[index];
+    if (!reader.present) {
+      continue;
+    }
+
+    if (reader.uses_irq()) {
+      if (reader.irq_fired) {
+        uint32_t latency = micros() - reader.irq_at_us;
+        uint32_t start = micros();
+        bool selected = reader.rfid.PICC_ReadCardSerial();
+        reader.bus_busy_us += micros() - start;
+
+        if (selected) {
+          reader.scans++;
+          reader.last_detect_us = latency;
+          reader.last_read_us = micros() - start;
+          reader.detect_latency_sum_us += latency;
+          if (latency > reader.detect_latency_max_us) {
+            reader.detect_latency_max_us = latency;
+          }
+          next_reader = (index + 1) % count;
+          return &reader;
+        }
+
+        reader.irq_fired = false;
+        reader_arm(reader);
+      } else if (now - reader.armed_at >= READER_IRQ_REARM_MS) {
+        reader.polls++;
+        reader_arm(reader);
+      }
+      continue;
+    }
+
+    if (reader.last_poll_at != 0 && now - reader.last_poll_at > reader.max_poll_gap_ms) {
+      reader.max_poll_gap_ms = now - reader.last_poll_at;
+    }
+    reader.last_poll_at = now;
+    reader.polls++;
+
+    uint32_t start = micros();
+    bool present = reader.rfid.PICC_IsNewCardPresent();
+    uint32_t detected_at = micros();
+    bool detected = present && reader.rfid.PICC_ReadCardSerial();
+    reader.bus_busy_us += micros() - start;
+
+    if (detected) {
+      reader.scans++;
+      reader.last_detect_us = detected_at - start;
+      reader.last_read_us = micros() - detected_at;
+      next_reader = (index + 1) % count;
+      return &reader;
+    }
+  }
+
+  return nullptr;
+}
+
+/**
+ * Finish with a reader after its card was handled
+ * Clears interrupts raised by the select/halt exchange and re-arms IRQ readers
+ * @param reader Reader returned by readers_poll()
+ */
+void readers_done(CardReader &reader) {
+  if (!reader.uses_irq()) {
+    return;
+  }
+  reader.irq_fired = false;
+  reader_arm(reader);
+}
+
+/**
+ * Sleep the main loop until a reader interrupt arrives or the timeout expires
+ * @param readers Reader table
+ * @param count Number of readers in the table
+ * @param timeout_ms Longest time to wait
+ */
+void readers_wait(CardReader *readers, size_t count, unsigned long timeout_ms) {
+  for (size_t i = 0; i < count; i++) {
+    if (readers[i].present && readers[i].uses_irq()) {
+      if (readers[i].irq_fired) {
+        return;
+      }
+      timeout_ms = min(timeout_ms, (unsigned long)READER_IRQ_REARM_MS);
+    }
+  }
+
+  uint32_t start = micros();
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms));
+  reader_idle_us += micros() - start;
+}
+
+/**
+ * Print per-reader metrics on Serial at a fixed interval
+ * bus_busy_us is time spent in SPI exchanges for detection; idle is time the
+ * main loop spent asleep waiting for a frame tick or a reader interrupt
+ * @param readers Reader table
+ * @param count Number of readers in the table
+ */
+void readers_report(CardReader *readers, size_t count) {
+  static unsigned long last_report = 0;
+  if (millis() - last_report < READER_REPORT_INTERVAL_MS) {
+    return;
+  }
+  last_report = millis();
+
+  for (size_t i = 0; i < count; i++) {
+    CardReader &reader = readers[i];
+    uint32_t avg_latency = reader.scans > 0 && reader.uses_irq()
+                               ? (uint32_t)(reader.detect_latency_sum_us / reader.scans)
+                               : 0;
+    Serial.printf("Reader %u (%s) mode=%s present=%d polls=%u scans=%u max_poll_gap_ms=%lu "
+                  "bus_busy_ms=%u detect_avg_us=%u detect_max_us=%u\n",
+                  reader.id, reader.label, reader.uses_irq() ? "irq" : "poll", reader.present,
+                  reader.polls, reader.scans, reader.max_poll_gap_ms,
+                  (uint32_t)(reader.bus_busy_us / 1000), avg_latency, reader.detect_latency_max_us);
+  }
+  Serial.printf("Scan loop idle: %u ms of %lu ms uptime\n", (uint32_t)(reader_idle_us / 1000), millis());
+}
@@ -5,68 +5,312 @@
 
 #include <Arduino.h>
 #include <HTTPClient.h>
-#include <WiFiClientSecure.h>
+#include <apps_script_client.h>
+#include <clock_sync.h>
+#include <device_config.h>
+#include <http_policy.h>
+#include <mqtt_transport.h>
+#include <scan_outbox.h>
 #include <secrets.h>
 
+// Apps Script web app endpoint, assembled at compile time
+// STANDIN_HOST (e.g. "http://192.168.1.50:8080") points it at tools/scan_replay.py
+#ifdef STANDIN_HOST
+#define APPS_SCRIPT_URL STANDIN_HOST "/macros/s/" APP_ID "/exec"
+#else
+#define APPS_SCRIPT_URL "https://script.google.com/macros/s/" APP_ID "/exec"
+#endif
+
+// Ask doGet for the compact binary roster; a script without it still answers JSON
+#ifndef ROSTER_BINARY
+#define ROSTER_BINARY 1
+#endif
+
+// Gzip the binary roster; inflated on the fly while it is decoded
+#ifndef ROSTER_GZIP
+#define ROSTER_GZIP 1
+#endif
+
+#if ROSTER_BINARY && ROSTER_GZIP
+#define ROSTER_QUERY "?read&format=bin&gzip=1"
+#elif ROSTER_BINARY
+#define ROSTER_QUERY "?read&format=bin"
+#else
+#define ROSTER_QUERY "?read"
+#endif
+
+// Fixed buffer for the attendance record payload
+#define SCAN_PAYLOAD_SIZE 256
+
+// Fixed buffer for doPost's reply, e.g. {"action":"time out","notified":true,"time_source":"device"}
+#define SCAN_RESPONSE_SIZE 128
+
+// Retry budgets: the roster fetch runs at boot, scan records run inline in the scan path
+const RequestPolicy roster_policy = {45000, 4, 1000, 8000};
+const RequestPolicy scan_policy = {6000, 2, 400, 1500};
+const RequestPolicy outbox_policy = {4000, 1, 0, 0};
+const RequestPolicy device_policy = {10000, 2, 1000, 4000};
+
+// Event identity, so Apps Script can drop a retried record it already stored
+static uint32_t scan_boot_id = 0;
+static uint32_t scan_event_seq = 0;
+
+// State for one roster fetch attempt
+struct RosterFetch {
+  String payload;
+};
+
+// State for one scan record attempt
+struct ScanPost {
+  const char *payload;
+  size_t length;
+  bool read_response;
+  char response[SCAN_RESPONSE_SIZE];
+};
+
+/**
+ * Single roster GET attempt
+ * @param context RosterFetch receiving the body
+ * @param budget_ms Remaining request budget
+ * @return HTTPClient result code
+ */
+int roster_attempt(void *context, unsigned long budget_ms) {
+  RosterFetch *fetch = (RosterFetch *)context;
+
+  unsigned long started = millis();
+  int httpCode = apps_script_request(APPS_SCRIPT_URL ROSTER_QUERY, nullptr, 0, budget_ms, &fetch->payload);
+  if (httpCode != HTTP_CODE_OK) {
+    fetch->payload = String();
+  } else {
+    Serial.printf("Roster download: %u bytes on the wire in %lu ms\n", fetch->payload.length(), millis() - started);
+  }
+  Serial.printf("Database request completed - HTTP %d (%s)\n", httpCode,
+                httpCode < 0 ? HTTPClient::errorToString(httpCode).c_str() : "response");
+  return httpCode;
+}
+
 /**
  * Fetch UID database from Google Apps Script
  * @return JSON string containing UID records
  */
 String spreadsheet_comm(void) {
-  HTTPClient http;
-  String url = "https://script.google.com/macros/s/" + String(APP_ID) + "/exec?read";
+  RosterFetch fetch;
 
   Serial.println("Fetching UID database...");
+  apps_script_acquire(portMAX_DELAY);
+  run_with_policy(apps_script_breaker, roster_policy, roster_attempt, &fetch);
+  apps_script_release();
+  return fetch.payload;
+}
+
+/**
+ * Single device config GET attempt
+ * @param context RosterFetch receiving the body
+ * @param budget_ms Remaining request budget
+ * @return HTTPClient result code
+ */
+int device_config_attempt(void *context, unsigned long budget_ms) {
+  RosterFetch *fetch = (RosterFetch *)context;
+  char url[sizeof(APPS_SCRIPT_URL) + 32];
+  snprintf(url, sizeof(url), APPS_SCRIPT_URL "?device=%s", device_id());
+  return apps_script_request(url, nullptr, 0, budget_ms, &fetch->payload);
+}
 
-  http.begin(url.c_str());
-  http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+/**
+ * Fetch this gate's settings from the Devices sheet and put them into effect
+ * The sheet registers a gate the first time it asks
+ * @return true if a config was received and applied
+ */
+bool fetch_device_config() {
+  RosterFetch fetch;
+  apps_script_acquire(portMAX_DELAY);
+  RequestOutcome outcome = run_with_policy(apps_script_breaker, device_policy, device_config_attempt, &fetch);
+  apps_script_release();
+  if (outcome != REQUEST_OK) {
+    Serial.println("Device config request failed, keeping the current config");
+    return false;
+  }
+  return device_config_apply(fetch.payload);
+}
 
-  int httpCode = http.GET();
-  String payload = "";
+/**
+ * Single attendance POST attempt
+ * @param context ScanPost with the payload
+ * @param budget_ms Remaining request budget
+ * @return HTTPClient result code
+ */
+int scan_post_attempt(void *context, unsigned long budget_ms) {
+  ScanPost *post = (ScanPost *)context;
+  return apps_script_request(APPS_SCRIPT_URL, post->payload, post->length, budget_ms, nullptr,
+                             post->read_response ? post->response : nullptr, sizeof(post->response));
+}
 
-  if (httpCode > 0) {
-    payload = http.getString();
-    Serial.println("Database request completed - HTTP " + String(httpCode));
-  } else {
-    Serial.println("Database request failed: " + http.errorToString(httpCode));
+/**
+ * Format the attendance record body doPost takes (also the MQTT scan event)
+ * "ts" is the UTC read time, left out while the clock is unsynced; "age_ms"
+ * is how long ago the card was read, on the boot clock
+ * @param scan Record to format
+ * @param out Output buffer
+ * @param out_size Output buffer size
+ * @return Payload length
+ */
+size_t format_scan_payload(const PendingScan &scan, char *out, size_t out_size) {
+  char read_time[32] = "";
+  int64_t read_epoch_ms = clock_stamp_epoch_ms(scan.read_at);
+  if (read_epoch_ms != 0) {
+    snprintf(read_time, sizeof(read_time), ",\"ts\":%lld", (long long)read_epoch_ms);
   }
-  
-  http.end();
-  return payload;
+  int length = snprintf(out, out_size,
+                        "{\"uid\":\"%s\",\"access_granted\":%s,\"reader\":%u,\"notify\":%s,\"event\":\"%08x-%u\","
+                        "\"device\":\"%s\"%s,\"age_ms\":%u}",
+                        scan.uid, scan.access_granted ? "true" : "false", scan.reader_id,
+                        scan.notify ? "true" : "false", scan_boot_id, scan.event_seq, device_id(), read_time,
+                        clock_stamp_age_ms(scan.read_at));
+  return (size_t)min(length, (int)out_size - 1);
+}
+
+/**
+ * Deliver one attendance record under a policy
+ * Never waits for the connections: while the roster sync holds them the record is queued
+ * When the record asks for a notification, doPost's response is read to see if it was sent
+ * @param scan Record to deliver
+ * @param policy Retry budget
+ * @param notified Set when doPost reports it posted the Discord notification (may be nullptr)
+ * @return Outcome of the delivery, REQUEST_BUSY if another request is running
+ */
+RequestOutcome post_scan_record(const PendingScan &scan, const RequestPolicy &policy, bool *notified = nullptr) {
+  char jsonPayload[SCAN_PAYLOAD_SIZE];
+  ScanPost post = {jsonPayload, format_scan_payload(scan, jsonPayload, sizeof(jsonPayload)),
+                   scan.notify && notified != nullptr, ""};
+  if (!apps_script_acquire(0)) {
+    return REQUEST_BUSY;
+  }
+  RequestOutcome outcome = run_with_policy(apps_script_breaker, policy, scan_post_attempt, &post);
+  apps_script_release();
+  if (notified != nullptr) {
+    // The webhook can be unset or failing, or the member unknown; only an explicit true counts
+    *notified = outcome == REQUEST_OK && strstr(post.response, "\"notified\":true") != nullptr;
+  }
+  return outcome;
 }
 
 /**
  * Record attendance data via Google Apps Script
+ * Records that cannot be delivered within the scan budget go to the outbox
  * @param uid RFID card identifier
  * @param access_granted Authorization status (true for valid users)
- * @return Action type string ("time in", "time out", or error message)
+ * @param reader_id Reader that produced the scan
+ * @param notify Ask Apps Script to post the Discord notification
+ * @param read_at When the card was read
+ * @param notified Set when Apps Script reports it posted the notification; otherwise the caller sends it
+ * @return true if Apps Script accepted the record
  */
-void send_scan_data(String uid, bool access_granted) {
-  WiFiClientSecure client;
-  client.setInsecure();
-  client.setTimeout(15000);
-  
-  HTTPClient http;
-  http.begin(client, "https://script.google.com/macros/s/" + String(APP_ID) + "/exec");
-  http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-  http.addHeader("Content-Type", "application/json");
-  http.addHeader("Accept", "application/json");
-  
-  // Construct attendance record payload
-  String jsonPayload = "{\"uid\":\"" + uid + "\",\"access_granted\":" + 
-                      (access_granted ? "true" : "false") + "}";
-  
-  Serial.println("Recording attendance for UID: " + uid);
-  
-  http.POST(jsonPayload);
-  // String response = http.getString();
-  
-  // if (httpCode == 200) {
-  //   Serial.println("Attendance recorded successfully");
-  // } else {
-  //   Serial.println("Attendance recording failed - HTTP " + String(httpCode));
-  // }
-  
-  // http.end();
-  // return response;
-}
\ No newline at end of file
+bool send_scan_data(const char *uid, bool access_granted, uint8_t reader_id, bool notify, const ScanStamp &read_at,
+                    bool &notified) {
+  if (scan_boot_id == 0) {
+    scan_boot_id = esp_random() | 1;
+  }
+
+  PendingScan scan;
+  strncpy(scan.uid, uid, sizeof(scan.uid) - 1);
+  scan.uid[sizeof(scan.uid) - 1] = '\0';
+  scan.access_granted = access_granted;
+  scan.reader_id = reader_id;
+  scan.notify = notify;
+  scan.event_seq = ++scan_event_seq;
+  scan.read_at = read_at;
+  notified = false;
+
+  Serial.printf("Recording attendance for UID: %s\n", uid);
+
+#if MQTT_TRANSPORT
+  // Over the broker session the record is handed off at once; QoS 1 and the event id cover delivery
+  // The bridge posts it to doPost later, so the gate sends the notification itself and the script must not repeat it
+  if (scan_outbox_count == 0) {
+    PendingScan handed_off = scan;
+    handed_off.notify = false;
+    char jsonPayload[SCAN_PAYLOAD_SIZE];
+    format_scan_payload(handed_off, jsonPayload, sizeof(jsonPayload));
+    if (mqtt_publish_scan(jsonPayload)) {
+      return true;
+    }
+  }
+#endif
+
+  // Keep ordering: while older records wait, queue behind them without trying the endpoint
+  RequestOutcome outcome = scan_outbox_count > 0
+                               ? REQUEST_QUEUED
+                               : post_scan_record(scan, scan_policy, &notified);
+  if (outcome == REQUEST_OK) {
+    return true;
+  }
+  if (outcome == REQUEST_CLIENT_ERROR) {
+    Serial.println("Attendance record rejected by Apps Script");
+    return false;
+  }
+
+  // The caller falls back to notifying Discord itself, so a late delivery must not repeat it
+  scan.notify = false;
+  scan_outbox_push(scan);
+  Serial.printf("Attendance record queued (%s), outbox depth %u\n",
+                request_outcome_names[outcome], scan_outbox_count);
+  return false;
+}
+
+/**
+ * Ask Apps Script to post the aggregated alert for an unknown card presented repeatedly
+ * Nothing is written to the sheet; the event id lets doPost answer a retry without posting twice
+ * Never waits for the connections, like the scan records
+ * @param uid Card UID
+ * @param attempts Attempts in the window
+ * @param window_s Window length in seconds
+ * @return true if doPost reports it posted the alert; otherwise the caller sends it
+ */
+bool post_denied_repeat_alert(const char *uid, uint32_t attempts, unsigned long window_s) {
+  if (scan_boot_id == 0) {
+    scan_boot_id = esp_random() | 1;
+  }
+  char jsonPayload[SCAN_PAYLOAD_SIZE];
+  int length = snprintf(jsonPayload, sizeof(jsonPayload),
+                        "{\"alert\":\"denied_repeat\",\"uid\":\"%s\",\"attempts\":%u,\"window_s\":%lu,"
+                        "\"event\":\"%08x-%u\",\"device\":\"%s\"}",
+                        uid, attempts, window_s, scan_boot_id, ++scan_event_seq, device_id());
+  ScanPost post = {jsonPayload, (size_t)min(length, (int)sizeof(jsonPayload) - 1), true, ""};
+  if (!apps_script_acquire(0)) {
+    return false;
+  }
+  RequestOutcome outcome = run_with_policy(apps_script_breaker, scan_policy, scan_post_attempt, &post);
+  apps_script_release();
+  return outcome == REQUEST_OK && strstr(post.response, "\"notified\":true") != nullptr;
+}
+
+/**
+ * Retry the oldest queued attendance record, at most one per call
+ * Called from the main loop between scans; an open breaker returns at once
+ */
+void drain_scan_outbox() {
+  static unsigned long last_attempt = 0;
+  PendingScan *scan = scan_outbox_peek();
+  if (scan == nullptr || millis() - last_attempt < 2000) {
+    return;
+  }
+#if MQTT_TRANSPORT
+  char jsonPayload[SCAN_PAYLOAD_SIZE];
+  format_scan_payload(*scan, jsonPayload, sizeof(jsonPayload));
+  if (mqtt_publish_scan(jsonPayload)) {
+    Serial.printf("Queued attendance record for %s handed to MQTT\n", scan->uid);
+    scan_outbox_pop();
+    return;
+  }
+#endif
+  if (breaker_blocking(apps_script_breaker)) {
+    return;
+  }
+  last_attempt = millis();
+
+  RequestOutcome outcome = post_scan_record(*scan, outbox_policy);
+  if (outcome == REQUEST_OK || outcome == REQUEST_CLIENT_ERROR) {
+    Serial.printf("Queued attendance record for %s delivered (%s)\n", scan->uid, request_outcome_names[outcome]);
+    scan_outbox_pop();
+  }
+}
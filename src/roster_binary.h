@@ -0,0 +1,255 @@
+/**
+ * Binary Roster Decoder
+ * Decodes the doGet ?format=bin roster, gzipped or not, straight from its
+ * base64 text into the users array, without ArduinoJson
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <new>
+#include <gzip_stream.h>
+#include <uid_format.h>
+#include <user_info.h>
+
+// Binary roster ("?read&format=bin"): base64 text of
+//   "GRB" version(1) count(u16 BE), then per member
+//   uid_len uid_bytes, then dlsu_id, name, discord_username each as len(u8) + UTF-8
+// With "&gzip=1" the same table is gzipped before base64 encoding
+#define ROSTER_BIN_MAGIC "GRB"
+#define ROSTER_BIN_VERSION 1
+#define ROSTER_BIN_HEADER_SIZE 6
+
+// Fewest bytes a member takes: the UID length and the three field lengths
+#define ROSTER_BIN_MIN_MEMBER_SIZE 4
+
+// Streaming base64 decoder over the roster text
+struct Base64Reader {
+  const char *next;
+  const char *end;
+  uint32_t bits;
+  uint8_t bit_count;
+  bool failed;
+};
+
+/**
+ * Decode the next byte
+ * @param reader Decoder state
+ * @return Byte value, or -1 at the end of the data (reader.failed is set if it ended early)
+ */
+int base64_next(Base64Reader &reader) {
+  while (reader.bit_count < 8) {
+    if (reader.next >= reader.end || *reader.next == '=') {
+      return -1;
+    }
+    char c = *reader.next++;
+    int value;
+    if (c >= 'A' && c <= 'Z') value = c - 'A';
+    else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+    else if (c >= '0' && c <= '9') value = c - '0' + 52;
+    else if (c == '+') value = 62;
+    else if (c == '/') value = 63;
+    else if (c == '\r' || c == '\n') continue;
+    else {
+      reader.failed = true;
+      return -1;
+    }
+    reader.bits = (reader.bits << 6) | value;
+    reader.bit_count += 6;
+  }
+  reader.bit_count -= 8;
+  return (reader.bits >> reader.bit_count) & 0xFF;
+}
+
+/**
+ * Byte source callback for the decoder
+ * @param context Base64Reader
+ * @return Byte value, or -1 at the end of the data
+ */
+int base64_byte(void *context) {
+  return base64_next(*(Base64Reader *)context);
+}
+
+/**
+ * Read a length-prefixed field
+ * @param next Byte source
+ * @param context Opaque pointer passed to the source
+ * @param out Output buffer, NUL-terminated
+ * @param out_size Output buffer size; longer fields are truncated
+ * @return Field length in the payload, or -1 if the data ended
+ */
+int roster_field(int (*next)(void *context), void *context, char *out, size_t out_size) {
+  int length = next(context);
+  if (length < 0) {
+    return -1;
+  }
+  size_t pos = 0;
+  for (int i = 0; i < length; i++) {
+    int c = next(context);
+    if (c < 0) {
+      return -1;
+    }
+    if (pos + 1 < out_size) {
+      out[pos++] = (char)c;
+    }
+  }
+  out[pos] = '\0';
+  return length;
+}
+
+/**
+ * Bytes of data in base64 text, an upper bound when the text holds line breaks
+ * @param text Base64 text
+ */
+size_t base64_decoded_size(const String &text) {
+  size_t length = text.length();
+  size_t padding = 0;
+  while (padding < 2 && padding < length && text[length - 1 - padding] == '=') {
+    padding++;
+  }
+  return (length + 3) / 4 * 3 - padding;
+}
+
+/**
+ * Inflated size a base64-encoded gzip member declares in its trailer (ISIZE)
+ * Only a claim until gzip_end() checks it, but enough to bound the member count
+ * @param text Base64 text of the gzip member
+ * @return Declared size, or 0 if the text is too short to hold a trailer
+ */
+size_t gzip_declared_size(const String &text) {
+  // The last 12 characters hold the last 9 or fewer bytes; ISIZE is the final 4
+  if (text.length() < 16 || text.length() % 4 != 0) {
+    return 0;
+  }
+  Base64Reader reader = {text.c_str() + text.length() - 12, text.c_str() + text.length(), 0, 0, false};
+  uint8_t tail[9];
+  size_t count = 0;
+  int value;
+  while (count < sizeof(tail) && (value = base64_next(reader)) >= 0) {
+    tail[count++] = value;
+  }
+  if (reader.failed || count < 4) {
+    return 0;
+  }
+  return (size_t)tail[count - 4] | (size_t)tail[count - 3] << 8 | (size_t)tail[count - 2] << 16 |
+         (size_t)tail[count - 1] << 24;
+}
+
+// Check whether roster text is the binary encoding ("GRB" or a gzip header in base64)
+bool roster_is_binary(const String &text) {
+  return text.startsWith("R1JC") || text.startsWith("H4sI");
+}
+
+/**
+ * Decode the binary roster table in one pass
+ * @param next Byte source
+ * @param context Opaque pointer passed to the source
+ * @param table_size Most bytes the table can hold; a member count it cannot fit is rejected
+ * @param users Receives the new array on success
+ * @param userCount Receives the member count, 0 on failure
+ */
+void decodeRosterTable(int (*next)(void *context), void *context, size_t table_size, UserInfo *&users,
+                       int &userCount) {
+  userCount = 0;
+
+  char field[256];
+  for (uint8_t i = 0; i < 3; i++) {
+    if (next(context) != ROSTER_BIN_MAGIC[i]) {
+      Serial.println("Binary roster: bad magic");
+      return;
+    }
+  }
+  int version = next(context);
+  int count_high = next(context);
+  int count_low = next(context);
+  if (version != ROSTER_BIN_VERSION || count_high < 0 || count_low < 0) {
+    Serial.println("Binary roster: unsupported version " + String(version));
+    return;
+  }
+
+  // The count comes from the server; check it before it sizes an allocation
+  int count = (count_high << 8) | count_low;
+  if (table_size < ROSTER_BIN_HEADER_SIZE ||
+      (size_t)count > (table_size - ROSTER_BIN_HEADER_SIZE) / ROSTER_BIN_MIN_MEMBER_SIZE) {
+    Serial.println("Binary roster: " + String(count) + " users cannot fit in " + String((unsigned)table_size) +
+                   " bytes");
+    return;
+  }
+  UserInfo *parsed = new (std::nothrow) UserInfo[count];
+  if (parsed == nullptr) {
+    Serial.println("Binary roster: no memory for " + String(count) + " users");
+    return;
+  }
+  bool failed = false;
+  for (int i = 0; i < count && !failed; i++) {
+    // Raw UID bytes, formatted the same way the readers format a scanned card
+    MFRC522::Uid uid;
+    int uid_size = next(context);
+    if (uid_size < 0 || uid_size > (int)sizeof(uid.uidByte)) {
+      break;
+    }
+    uid.size = uid_size;
+    for (int b = 0; b < uid_size; b++) {
+      int value = next(context);
+      uid.uidByte[b] = value < 0 ? 0 : value;
+      failed = failed || value < 0;
+    }
+    char uid_text[UID_TEXT_SIZE];
+    format_uid(uid, uid_text, sizeof(uid_text));
+    parsed[i].uid = uid_text;
+
+    if (roster_field(next, context, field, sizeof(field)) < 0) break;
+    parsed[i].dlsu_id = field;
+    if (roster_field(next, context, field, sizeof(field)) < 0) break;
+    parsed[i].name = field;
+    if (roster_field(next, context, field, sizeof(field)) < 0) break;
+    parsed[i].discord_username = field;
+    userCount = failed ? i : i + 1;
+  }
+
+  if (userCount != count) {
+    Serial.println("Binary roster truncated after " + String(userCount) + " of " + String(count) + " users");
+    delete[] parsed;
+    userCount = 0;
+    return;
+  }
+  users = parsed;
+}
+
+// Function to decode the binary roster, gzipped or not, and fill the users array in one pass
+void binaryToHashmap(const String &text, UserInfo *&users, int &userCount) {
+  Base64Reader reader = {text.c_str(), text.c_str() + text.length(), 0, 0, false};
+  userCount = 0;
+
+  if (!text.startsWith("H4sI")) {
+    decodeRosterTable(base64_byte, &reader, base64_decoded_size(text), users, userCount);
+    if (reader.failed && userCount > 0) {
+      delete[] users;
+      users = nullptr;
+      userCount = 0;
+    }
+  } else {
+    // Inflated on the fly: only the LZ window is held, never the whole table
+    GzipStream gz;
+    uint32_t free_before = ESP.getFreeHeap();
+    unsigned long started = micros();
+    if (gzip_begin(gz, base64_byte, &reader)) {
+      decodeRosterTable(gzip_next, &gz, gzip_declared_size(text), users, userCount);
+    }
+    bool intact = gzip_end(gz) && !reader.failed;
+    Serial.printf("Roster inflated: %u bytes on the wire, %u compressed, %u inflated, "
+                  "peak %u bytes of heap, %lu us\n",
+                  text.length(), gz.compressed, gz.inflated, free_before - gz.low_heap, micros() - started);
+    if (!intact && userCount > 0) {
+      delete[] users;
+      users = nullptr;
+      userCount = 0;
+    }
+  }
+
+  if (userCount > 0) {
+    Serial.println("Successfully decoded binary roster with " + String(userCount) + " users");
+  } else {
+    Serial.println("Binary roster rejected");
+  }
+}
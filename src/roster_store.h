@@ -0,0 +1,68 @@
+/**
+ * Roster Store
+ * Keeps the last downloaded roster in flash so the gate can admit members
+ * before the network is up
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#define ROSTER_STORE_PATH "/roster.json"
+#define ROSTER_STORE_TEMP "/roster.tmp"
+
+static bool roster_store_mounted = false;
+
+/**
+ * Mount the filesystem, formatting it the first time
+ * @return true if the store is usable
+ */
+bool roster_store_begin() {
+  roster_store_mounted = LittleFS.begin(true);
+  if (!roster_store_mounted) {
+    Serial.println("Roster store unavailable (LittleFS mount failed)");
+  }
+  return roster_store_mounted;
+}
+
+/**
+ * Read the stored roster
+ * @return Roster JSON, or an empty string if none is stored
+ */
+String roster_store_load() {
+  if (!roster_store_mounted || !LittleFS.exists(ROSTER_STORE_PATH)) {
+    return String();
+  }
+  File file = LittleFS.open(ROSTER_STORE_PATH, "r");
+  if (!file) {
+    return String();
+  }
+  String json = file.readString();
+  file.close();
+  return json;
+}
+
+/**
+ * Replace the stored roster; written to a temporary file first so a reset
+ * mid-write leaves the previous copy intact
+ * @param json Roster JSON
+ * @return true if written
+ */
+bool roster_store_save(const String &json) {
+  if (!roster_store_mounted) {
+    return false;
+  }
+  File file = LittleFS.open(ROSTER_STORE_TEMP, "w");
+  if (!file) {
+    return false;
+  }
+  size_t written = file.print(json);
+  file.close();
+  if (written != json.length()) {
+    LittleFS.remove(ROSTER_STORE_TEMP);
+    return false;
+  }
+  LittleFS.remove(ROSTER_STORE_PATH);
+  return LittleFS.rename(ROSTER_STORE_TEMP, ROSTER_STORE_PATH);
+}
@@ -0,0 +1,74 @@
+/**
+ * Duplicate Scan Guard
+ * Suppresses repeat reads of the same card within a short cooldown window
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+// Guard configuration (override with build flags if needed)
+#ifndef SCAN_COOLDOWN_MS
+#define SCAN_COOLDOWN_MS 5000
+#endif
+
+#ifndef SCAN_GUARD_SLOTS
+#define SCAN_GUARD_SLOTS 8
+#endif
+
+// Recently seen card entry
+struct RecentScan {
+  char uid[32];
+  unsigned long seen_at;
+};
+
+// Cooldown in effect; the Devices sheet can override the build default
+static uint32_t scan_cooldown_ms = SCAN_COOLDOWN_MS;
+
+static RecentScan recent_scans[SCAN_GUARD_SLOTS];
+static uint8_t recent_scan_next = 0;
+static uint32_t suppressed_scan_count = 0;
+
+/**
+ * Check a scanned UID against the recent scan table
+ * Records the UID when it is accepted so the cooldown starts from this read
+ * @param uid Formatted card UID
+ * @return true if the scan falls inside the cooldown window and must be suppressed
+ */
+bool scan_guard_check(const char *uid) {
+  unsigned long now = millis();
+
+  for (uint8_t i = 0; i < SCAN_GUARD_SLOTS; i++) {
+    RecentScan &entry = recent_scans[i];
+    if (entry.uid[0] == '\0' || strcmp(entry.uid, uid) != 0) {
+      continue;
+    }
+
+    if (now - entry.seen_at < scan_cooldown_ms) {
+      // Refresh so a card held on the reader stays suppressed
+      entry.seen_at = now;
+      suppressed_scan_count++;
+      return true;
+    }
+
+    // Cooldown expired - accept and restart the window in place
+    entry.seen_at = now;
+    return false;
+  }
+
+  // Not seen recently - overwrite the oldest slot
+  RecentScan &slot = recent_scans[recent_scan_next];
+  strncpy(slot.uid, uid, sizeof(slot.uid) - 1);
+  slot.uid[sizeof(slot.uid) - 1] = '\0';
+  slot.seen_at = now;
+  recent_scan_next = (recent_scan_next + 1) % SCAN_GUARD_SLOTS;
+  return false;
+}
+
+/**
+ * Number of scans dropped by the cooldown since boot
+ * @return Suppressed scan count
+ */
+uint32_t scan_guard_suppressed() {
+  return suppressed_scan_count;
+}
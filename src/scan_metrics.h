@@ -0,0 +1,142 @@
+/**
+ * Scan Path Latency Metrics
+ * Fixed-bucket histograms of each stage of the scan path
+ * Build with -D SCAN_METRICS=0 to compile all recording out
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef SCAN_METRICS
+#define SCAN_METRICS 1
+#endif
+
+// Interval between histogram summaries on Serial
+#ifndef SCAN_METRICS_REPORT_MS
+#define SCAN_METRICS_REPORT_MS 600000
+#endif
+
+// Stages of a single scan, in the order they happen
+enum ScanStage {
+  STAGE_DETECT,
+  STAGE_UID_READ,
+  STAGE_BUZZ_SCAN,
+  STAGE_OLED_VERIFY,
+  STAGE_LOOKUP,
+  STAGE_APPS_SCRIPT,
+  STAGE_DISCORD,
+  STAGE_OLED_RESULT,
+  STAGE_BUZZ_RESULT,
+  STAGE_TOTAL,
+  STAGE_COUNT
+};
+
+#if SCAN_METRICS
+
+// Power-of-two microsecond buckets: bucket n holds [2^n, 2^(n+1)) us, up to ~33 s
+#define SCAN_METRICS_BUCKETS 25
+
+struct StageHistogram {
+  uint32_t buckets[SCAN_METRICS_BUCKETS];
+  uint32_t count;
+  uint32_t errors;
+  uint64_t total_us;
+  uint32_t max_us;
+};
+
+static StageHistogram stage_histograms[STAGE_COUNT];
+
+const char *const stage_names[STAGE_COUNT] = {
+  "detect", "uid_read", "buzz_scan", "oled_verify", "lookup", "apps_script", "discord", "oled_result", "buzz_result",
+  "total"
+};
+
+/**
+ * Add one duration sample to a stage histogram
+ * @param stage Scan stage
+ * @param duration_us Stage duration in microseconds
+ */
+void scan_metrics_record(ScanStage stage, uint32_t duration_us) {
+  StageHistogram &hist = stage_histograms[stage];
+  uint8_t bucket = duration_us == 0 ? 0 : 31 - __builtin_clz(duration_us);
+  if (bucket >= SCAN_METRICS_BUCKETS) {
+    bucket = SCAN_METRICS_BUCKETS - 1;
+  }
+
+  hist.buckets[bucket]++;
+  hist.count++;
+  hist.total_us += duration_us;
+  if (duration_us > hist.max_us) {
+    hist.max_us = duration_us;
+  }
+}
+
+/**
+ * Count a failed stage (e.g. a rejected HTTP request)
+ * @param stage Scan stage
+ */
+void scan_metrics_error(ScanStage stage) {
+  stage_histograms[stage].errors++;
+}
+
+/**
+ * Estimate a percentile from the bucket counts
+ * @param hist Stage histogram
+ * @param percentile Percentile between 0 and 100
+ * @return Upper bound of the bucket holding the percentile, in microseconds
+ */
+uint32_t scan_metrics_percentile(const StageHistogram &hist, uint8_t percentile) {
+  if (hist.count == 0) {
+    return 0;
+  }
+
+  uint32_t rank = (uint32_t)(((uint64_t)hist.count * percentile + 99) / 100);
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < SCAN_METRICS_BUCKETS; i++) {
+    seen += hist.buckets[i];
+    if (seen >= rank) {
+      uint32_t upper = (i + 1 < 32) ? (1UL << (i + 1)) : UINT32_MAX;
+      return min(upper, hist.max_us);
+    }
+  }
+  return hist.max_us;
+}
+
+/**
+ * Print a summary line per stage on Serial at a fixed interval
+ */
+void scan_metrics_report() {
+  static unsigned long last_report = 0;
+  if (millis() - last_report < SCAN_METRICS_REPORT_MS) {
+    return;
+  }
+  last_report = millis();
+
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    const StageHistogram &hist = stage_histograms[i];
+    if (hist.count == 0 && hist.errors == 0) {
+      continue;
+    }
+    Serial.printf("Stage %s n=%u err=%u p50_us=%u p95_us=%u p99_us=%u max_us=%u total_ms=%u\n",
+                  stage_names[i], hist.count, hist.errors,
+                  scan_metrics_percentile(hist, 50), scan_metrics_percentile(hist, 95),
+                  scan_metrics_percentile(hist, 99), hist.max_us, (uint32_t)(hist.total_us / 1000));
+  }
+}
+
+#define SCAN_TIMER(name) uint32_t name = micros()
+#define SCAN_STAGE(stage, start) scan_metrics_record(stage, micros() - (start))
+#define SCAN_STAGE_US(stage, duration_us) scan_metrics_record(stage, duration_us)
+#define SCAN_STAGE_ERROR(stage) scan_metrics_error(stage)
+#define SCAN_METRICS_REPORT() scan_metrics_report()
+
+#else
+
+#define SCAN_TIMER(name)
+#define SCAN_STAGE(stage, start)
+#define SCAN_STAGE_US(stage, duration_us)
+#define SCAN_STAGE_ERROR(stage)
+#define SCAN_METRICS_REPORT()
+
+#endif
@@ -0,0 +1,63 @@
+/**
+ * Scan Outbox
+ * Fixed ring of attendance records that could not be delivered yet
+ * Records are retried from the main loop once the Apps Script breaker allows it
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <clock_sync.h>
+
+#ifndef SCAN_OUTBOX_SLOTS
+#define SCAN_OUTBOX_SLOTS 16
+#endif
+
+// Pending attendance record
+struct PendingScan {
+  char uid[32];
+  bool access_granted;
+  uint8_t reader_id;
+  bool notify;
+  uint32_t event_seq;
+  ScanStamp read_at;
+};
+
+static PendingScan scan_outbox[SCAN_OUTBOX_SLOTS];
+static uint8_t scan_outbox_head = 0;
+static volatile uint8_t scan_outbox_count = 0;
+static volatile uint32_t scan_outbox_dropped = 0;
+
+/**
+ * Queue a record for later delivery
+ * When the ring is full the oldest record is dropped to make room
+ * @param scan Record to queue
+ */
+void scan_outbox_push(const PendingScan &scan) {
+  if (scan_outbox_count == SCAN_OUTBOX_SLOTS) {
+    scan_outbox_head = (scan_outbox_head + 1) % SCAN_OUTBOX_SLOTS;
+    scan_outbox_count--;
+    scan_outbox_dropped++;
+  }
+  scan_outbox[(scan_outbox_head + scan_outbox_count) % SCAN_OUTBOX_SLOTS] = scan;
+  scan_outbox_count++;
+}
+
+/**
+ * Oldest queued record
+ * @return Pointer to the record, or nullptr if the outbox is empty
+ */
+PendingScan *scan_outbox_peek() {
+  return scan_outbox_count > 0 ? &scan_outbox[scan_outbox_head] : nullptr;
+}
+
+/**
+ * Remove the oldest queued record after it was delivered
+ */
+void scan_outbox_pop() {
+  if (scan_outbox_count == 0) {
+    return;
+  }
+  scan_outbox_head = (scan_outbox_head + 1) % SCAN_OUTBOX_SLOTS;
+  scan_outbox_count--;
+}
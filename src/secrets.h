@@ -10,3 +10,9 @@
 
 // If code expects a DISCORD_TTS constant (optional)
 #define DISCORD_TTS ""
+
+// MQTT broker for -D MQTT_TRANSPORT=1 (e.g. a local Mosquitto)
+// #define MQTT_HOST "192.168.1.50"
+// #define MQTT_PORT 1883
+// #define MQTT_USER ""
+// #define MQTT_PASS ""
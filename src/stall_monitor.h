@@ -0,0 +1,230 @@
+/**
+ * Stall Monitor
+ * Times loop() and the blocking calls inside it, and flags the ones that run long
+ *
+ * STALL_SCOPE("name") at the top of a block times it until the block exits.
+ * Every site keeps call counts, total and maximum time; a call over its limit
+ * (STALL_THRESHOLD_MS unless given) is logged with its site, line and task and
+ * competes for a place in the worst-offenders table. The loop task is also
+ * subscribed to the task watchdog: if one iteration hangs past
+ * STALL_WDT_TIMEOUT_S the gate resets, and the scope it was stuck in is
+ * reported after the reboot. Build with -D STALL_MONITOR=0 to compile it out.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <esp_task_wdt.h>
+
+#ifndef STALL_MONITOR
+#define STALL_MONITOR 1
+#endif
+
+// Default limit for a timed call
+#ifndef STALL_THRESHOLD_MS
+#define STALL_THRESHOLD_MS 250
+#endif
+
+// One HTTP attempt, connect through response
+#ifndef STALL_HTTP_THRESHOLD_MS
+#define STALL_HTTP_THRESHOLD_MS 2500
+#endif
+
+// One loop() pass; a scan with its HTTP calls and feedback normally takes a few seconds
+#ifndef STALL_LOOP_THRESHOLD_MS
+#define STALL_LOOP_THRESHOLD_MS 3000
+#endif
+
+// Longest a loop() pass may run before the task watchdog resets the gate
+#ifndef STALL_WDT_TIMEOUT_S
+#define STALL_WDT_TIMEOUT_S 30
+#endif
+
+#if STALL_MONITOR
+
+#define STALL_SITES 16
+#define STALL_WORST 8
+#define STALL_OPEN_MAGIC 0x5354414C
+
+// Timing totals for one call site
+struct StallSite {
+  const char *name;
+  uint32_t calls;
+  uint32_t stalls;
+  uint64_t total_us;
+  uint32_t max_us;
+};
+
+// One flagged stall
+struct StallRecord {
+  const char *site;
+  uint16_t line;
+  char task[16];
+  uint32_t duration_ms;
+  uint32_t at_ms;
+};
+
+// Innermost scope open on the watched task, kept across the watchdog reset
+struct StallOpenScope {
+  uint32_t magic;
+  char site[24];
+  uint16_t line;
+};
+
+static StallSite stall_sites[STALL_SITES];
+static StallRecord stall_worst[STALL_WORST];
+static volatile uint32_t stall_count = 0;
+static portMUX_TYPE stall_mux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t stall_watched_task = nullptr;
+static RTC_NOINIT_ATTR StallOpenScope stall_open;
+static StallOpenScope stall_last_reset = {0, "", 0};
+
+/**
+ * Add one timed call to its site and, over the limit, to the worst table
+ * @param site Call site name (a string literal)
+ * @param line Source line of the scope
+ * @param duration_us How long the call took
+ * @param limit_ms Stall limit for this call
+ */
+void stall_record(const char *site, uint16_t line, uint32_t duration_us, uint32_t limit_ms) {
+  bool stalled = duration_us / 1000 > limit_ms;
+  StallRecord record;
+  if (stalled) {
+    record.site = site;
+    record.line = line;
+    strncpy(record.task, pcTaskGetTaskName(nullptr), sizeof(record.task) - 1);
+    record.task[sizeof(record.task) - 1] = '\0';
+    record.duration_ms = duration_us / 1000;
+    record.at_ms = millis();
+  }
+
+  portENTER_CRITICAL(&stall_mux);
+  for (uint8_t i = 0; i < STALL_SITES; i++) {
+    StallSite &entry = stall_sites[i];
+    if (entry.name == nullptr) {
+      entry.name = site;
+    }
+    if (entry.name == site || strcmp(entry.name, site) == 0) {
+      entry.calls++;
+      entry.total_us += duration_us;
+      entry.max_us = max(entry.max_us, duration_us);
+      entry.stalls += stalled ? 1 : 0;
+      break;
+    }
+  }
+  if (stalled) {
+    stall_count++;
+    // Replace the mildest entry in the worst table if this one is longer
+    uint8_t mildest = 0;
+    for (uint8_t i = 1; i < STALL_WORST; i++) {
+      if (stall_worst[i].duration_ms < stall_worst[mildest].duration_ms) {
+        mildest = i;
+      }
+    }
+    if (record.duration_ms > stall_worst[mildest].duration_ms) {
+      stall_worst[mildest] = record;
+    }
+  }
+  portEXIT_CRITICAL(&stall_mux);
+
+  if (stalled) {
+    Serial.printf("STALL %s (line %u) took %u ms on %s, limit %u ms\n", site, line, record.duration_ms,
+                  record.task, limit_ms);
+  }
+}
+
+// Times the enclosing block; use through STALL_SCOPE / STALL_SCOPE_LIMIT
+class StallScope {
+ public:
+  StallScope(const char *site, uint16_t line, uint32_t limit_ms)
+      : site_(site), line_(line), limit_ms_(limit_ms), started_(micros()), watched_(false) {
+    if (stall_watched_task != nullptr && xTaskGetCurrentTaskHandle() == stall_watched_task) {
+      watched_ = true;
+      previous_ = stall_open;
+      stall_open.magic = STALL_OPEN_MAGIC;
+      strncpy(stall_open.site, site, sizeof(stall_open.site) - 1);
+      stall_open.site[sizeof(stall_open.site) - 1] = '\0';
+      stall_open.line = line;
+    }
+  }
+
+  ~StallScope() {
+    if (watched_) {
+      stall_open = previous_;
+    }
+    stall_record(site_, line_, micros() - started_, limit_ms_);
+  }
+
+ private:
+  const char *site_;
+  uint16_t line_;
+  uint32_t limit_ms_;
+  uint32_t started_;
+  bool watched_;
+  StallOpenScope previous_;
+};
+
+#define STALL_CONCAT_(a, b) a##b
+#define STALL_CONCAT(a, b) STALL_CONCAT_(a, b)
+#define STALL_SCOPE(site) StallScope STALL_CONCAT(stall_scope_, __LINE__)(site, __LINE__, STALL_THRESHOLD_MS)
+#define STALL_SCOPE_LIMIT(site, limit_ms) StallScope STALL_CONCAT(stall_scope_, __LINE__)(site, __LINE__, limit_ms)
+
+/**
+ * Subscribe the calling task (the loop task) to the task watchdog
+ * Also reports the scope a previous watchdog reset interrupted
+ */
+void stall_watchdog_begin() {
+  if (esp_reset_reason() == ESP_RST_TASK_WDT && stall_open.magic == STALL_OPEN_MAGIC) {
+    stall_last_reset = stall_open;
+    Serial.printf("Last reset: task watchdog, loop was stuck in %s (line %u)\n", stall_last_reset.site,
+                  stall_last_reset.line);
+  }
+  memset(&stall_open, 0, sizeof(stall_open));
+
+  // IDF 4.4 reconfigures the watchdog the core already started
+  esp_task_wdt_init(STALL_WDT_TIMEOUT_S, true);
+  stall_watched_task = xTaskGetCurrentTaskHandle();
+  esp_task_wdt_add(stall_watched_task);
+}
+
+// Called once per loop() pass
+void stall_watchdog_feed() {
+  esp_task_wdt_reset();
+}
+
+/**
+ * Copy the worst-offenders table, longest first
+ * @param out Receives up to STALL_WORST records
+ * @return Number of records copied
+ */
+uint8_t stall_worst_sorted(StallRecord *out) {
+  portENTER_CRITICAL(&stall_mux);
+  memcpy(out, stall_worst, sizeof(stall_worst));
+  portEXIT_CRITICAL(&stall_mux);
+
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < STALL_WORST; i++) {
+    if (out[i].duration_ms > 0) {
+      out[count++] = out[i];
+    }
+  }
+  for (uint8_t i = 1; i < count; i++) {
+    StallRecord record = out[i];
+    int8_t j = i - 1;
+    while (j >= 0 && out[j].duration_ms < record.duration_ms) {
+      out[j + 1] = out[j];
+      j--;
+    }
+    out[j + 1] = record;
+  }
+  return count;
+}
+
+#else
+
+#define STALL_SCOPE(site)
+#define STALL_SCOPE_LIMIT(site, limit_ms)
+#define stall_watchdog_begin()
+#define stall_watchdog_feed()
+
+#endif
@@ -0,0 +1,459 @@
+/**
+ * TLS Session Client
+ * WiFiClient with certificate validation and TLS session resumption
+ *
+ * The session (ticket or ID) from the last handshake with a host is offered on
+ * the next connect, so a reconnect skips the certificate chain and ECDHE. Each
+ * session is also serialized into RTC memory and survives soft resets.
+ * The bulk cipher is pinned to AES-GCM so record encryption runs on the ESP32 AES
+ * block; SHA and the bignum math behind the handshake already use the accelerators
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClient.h>
+#include <esp_system.h>
+#include <lwip/sockets.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/x509_crt.h>
+
+#ifndef TLS_HANDSHAKE_TIMEOUT_MS
+#define TLS_HANDSHAKE_TIMEOUT_MS 10000
+#endif
+
+// Serialized session bytes kept in RTC memory per host; larger sessions stay in RAM only
+#ifndef TLS_SESSION_PERSIST_SIZE
+#define TLS_SESSION_PERSIST_SIZE 1536
+#endif
+
+#define TLS_SESSION_MAGIC 0x544C5331
+
+// One session slot per host the gate talks to
+enum TlsSlot {
+  TLS_SLOT_APPS_SCRIPT_EXEC,
+  TLS_SLOT_APPS_SCRIPT_ECHO,
+  TLS_SLOT_DISCORD,
+  TLS_SLOT_COUNT
+};
+
+enum TlsHandshakeKind {
+  TLS_HANDSHAKE_FULL,
+  TLS_HANDSHAKE_RESUMED,
+  TLS_HANDSHAKE_KIND_COUNT
+};
+
+const char *const tls_handshake_names[TLS_HANDSHAKE_KIND_COUNT] = {"full", "resumed"};
+
+// ECDSA suites only: both Google and Discord then present chains that end at GTS Root R4
+static const int tls_ciphersuites[] = {
+  MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+  MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+  0
+};
+
+// Session saved across soft resets
+struct PersistedSession {
+  uint32_t magic;
+  uint16_t length;
+  uint8_t data[TLS_SESSION_PERSIST_SIZE];
+};
+
+static RTC_NOINIT_ATTR PersistedSession tls_persisted[TLS_SLOT_COUNT];
+
+class TlsSessionClient : public WiFiClient {
+ public:
+  const char *name;
+  volatile uint32_t handshakes[TLS_HANDSHAKE_KIND_COUNT];
+  volatile uint64_t handshake_us[TLS_HANDSHAKE_KIND_COUNT];
+
+  TlsSessionClient();
+  TlsSessionClient(const TlsSessionClient &) = delete;
+  TlsSessionClient &operator=(const TlsSessionClient &) = delete;
+  ~TlsSessionClient();
+
+  void configure(const char *client_name, TlsSlot client_slot, const char *ca_pem);
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(IPAddress ip, uint16_t port, int32_t timeout) override;
+  int connect(const char *host, uint16_t port) override;
+  int connect(const char *host, uint16_t port, int32_t timeout) override;
+  size_t write(uint8_t data) override;
+  size_t write(const uint8_t *buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+
+ private:
+  TlsSlot slot;
+  const char *ca;
+  bool ready;
+  bool restored;
+  bool tls_up;
+  bool have_session;
+  bool certificate_seen;
+  int peeked;
+  mbedtls_net_context net;
+  mbedtls_ssl_context ssl;
+  mbedtls_ssl_config conf;
+  mbedtls_ssl_session session;
+  mbedtls_entropy_context entropy;
+  mbedtls_ctr_drbg_context drbg;
+  mbedtls_x509_crt ca_chain;
+
+  bool setup();
+  void restore_session();
+  void save_session();
+  static int on_verify(void *context, mbedtls_x509_crt *crt, int depth, uint32_t *flags);
+};
+
+// Configured clients, for the metrics server
+static TlsSessionClient *tls_clients[TLS_SLOT_COUNT];
+
+TlsSessionClient::TlsSessionClient()
+    : name("tls"), slot(TLS_SLOT_COUNT), ca(nullptr), ready(false), restored(false), tls_up(false),
+      have_session(false), certificate_seen(false), peeked(-1) {
+  for (uint8_t i = 0; i < TLS_HANDSHAKE_KIND_COUNT; i++) {
+    handshakes[i] = 0;
+    handshake_us[i] = 0;
+  }
+  mbedtls_net_init(&net);
+  mbedtls_ssl_init(&ssl);
+  mbedtls_ssl_config_init(&conf);
+  mbedtls_ssl_session_init(&session);
+  mbedtls_entropy_init(&entropy);
+  mbedtls_ctr_drbg_init(&drbg);
+  mbedtls_x509_crt_init(&ca_chain);
+}
+
+TlsSessionClient::~TlsSessionClient() {
+  stop();
+  mbedtls_ssl_session_free(&session);
+  mbedtls_ssl_config_free(&conf);
+  mbedtls_ctr_drbg_free(&drbg);
+  mbedtls_entropy_free(&entropy);
+  mbedtls_x509_crt_free(&ca_chain);
+}
+
+/**
+ * Bind the client to a session slot and trust anchor
+ * Parsing and RNG seeding are deferred to the first connect
+ * @param client_name Name used in logs and metrics
+ * @param client_slot Session slot (one per host)
+ * @param ca_pem PEM trust anchor the server chain must end at
+ */
+void TlsSessionClient::configure(const char *client_name, TlsSlot client_slot, const char *ca_pem) {
+  name = client_name;
+  slot = client_slot;
+  ca = ca_pem;
+  if (slot < TLS_SLOT_COUNT) {
+    tls_clients[slot] = this;
+  }
+}
+
+/**
+ * One-time mbedtls setup: RNG, trust anchor, cipher suites and tickets
+ * @return true when the client can connect
+ */
+bool TlsSessionClient::setup() {
+  if (ready) {
+    return true;
+  }
+  if (ca == nullptr) {
+    Serial.printf("TLS %s has no trust anchor configured\n", name);
+    return false;
+  }
+
+  int ret = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy,
+                                  (const unsigned char *)name, strlen(name));
+  if (ret == 0) {
+    ret = mbedtls_x509_crt_parse(&ca_chain, (const unsigned char *)ca, strlen(ca) + 1);
+  }
+  if (ret == 0) {
+    ret = mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                      MBEDTLS_SSL_PRESET_DEFAULT);
+  }
+  if (ret != 0) {
+    Serial.printf("TLS %s setup failed (-0x%04x)\n", name, -ret);
+    return false;
+  }
+
+  mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+  mbedtls_ssl_conf_ca_chain(&conf, &ca_chain, nullptr);
+  mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+  mbedtls_ssl_conf_verify(&conf, on_verify, this);
+  mbedtls_ssl_conf_ciphersuites(&conf, tls_ciphersuites);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+  mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+  ready = true;
+  restore_session();
+  return true;
+}
+
+/**
+ * Called for each certificate checked; only full handshakes check certificates
+ */
+int TlsSessionClient::on_verify(void *context, mbedtls_x509_crt *crt, int depth, uint32_t *flags) {
+  ((TlsSessionClient *)context)->certificate_seen = true;
+  return 0;
+}
+
+/**
+ * Load the session saved in RTC memory before a soft reset
+ */
+void TlsSessionClient::restore_session() {
+  if (restored || slot >= TLS_SLOT_COUNT) {
+    return;
+  }
+  restored = true;
+
+  // RTC memory holds garbage after a power-on reset
+  PersistedSession &saved = tls_persisted[slot];
+  if (esp_reset_reason() == ESP_RST_POWERON || saved.magic != TLS_SESSION_MAGIC ||
+      saved.length > TLS_SESSION_PERSIST_SIZE) {
+    return;
+  }
+  if (mbedtls_ssl_session_load(&session, saved.data, saved.length) == 0) {
+    have_session = true;
+    Serial.printf("TLS %s session restored from RTC memory\n", name);
+  } else {
+    mbedtls_ssl_session_free(&session);
+    mbedtls_ssl_session_init(&session);
+  }
+}
+
+/**
+ * Keep the session of the current connection for the next connect and in RTC memory
+ */
+void TlsSessionClient::save_session() {
+  mbedtls_ssl_session_free(&session);
+  mbedtls_ssl_session_init(&session);
+  have_session = mbedtls_ssl_get_session(&ssl, &session) == 0;
+  if (!have_session || slot >= TLS_SLOT_COUNT) {
+    return;
+  }
+
+  PersistedSession &saved = tls_persisted[slot];
+  size_t length = 0;
+  saved.magic = 0;
+  if (mbedtls_ssl_session_save(&session, saved.data, sizeof(saved.data), &length) == 0) {
+    saved.length = length;
+    saved.magic = TLS_SESSION_MAGIC;
+  }
+}
+
+int TlsSessionClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip, port, TLS_HANDSHAKE_TIMEOUT_MS);
+}
+
+/**
+ * Connecting by address is refused: the certificate is checked against a host name
+ */
+int TlsSessionClient::connect(IPAddress ip, uint16_t port, int32_t timeout) {
+  Serial.printf("TLS %s needs a host name to verify, refusing %s\n", name, ip.toString().c_str());
+  return 0;
+}
+
+int TlsSessionClient::connect(const char *host, uint16_t port) {
+  return connect(host, port, TLS_HANDSHAKE_TIMEOUT_MS);
+}
+
+/**
+ * Open the TCP connection and run the handshake, offering the saved session
+ * @param host Server name, used for SNI and certificate verification
+ * @param port Server port
+ * @param timeout Connect plus handshake budget in milliseconds
+ * @return 1 on success, 0 on failure
+ */
+int TlsSessionClient::connect(const char *host, uint16_t port, int32_t timeout) {
+  stop();
+  if (!setup()) {
+    return 0;
+  }
+
+  unsigned long started = millis();
+  IPAddress address;
+  if (!WiFi.hostByName(host, address) || !WiFiClient::connect(address, port, timeout)) {
+    return 0;
+  }
+
+  net.fd = fd();
+  fcntl(net.fd, F_SETFL, fcntl(net.fd, F_GETFL, 0) | O_NONBLOCK);
+
+  int ret = mbedtls_ssl_setup(&ssl, &conf);
+  if (ret == 0) {
+    ret = mbedtls_ssl_set_hostname(&ssl, host);
+  }
+  if (ret == 0 && have_session) {
+    mbedtls_ssl_set_session(&ssl, &session);
+  }
+  mbedtls_ssl_set_bio(&ssl, &net, mbedtls_net_send, mbedtls_net_recv, nullptr);
+
+  certificate_seen = false;
+  uint32_t handshake_start = micros();
+  while (ret == 0 && (ret = mbedtls_ssl_handshake(&ssl)) != 0) {
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      break;
+    }
+    if (millis() - started > (unsigned long)timeout) {
+      break;
+    }
+    ret = 0;
+    delay(2);
+  }
+
+  if (ret != 0) {
+    // The saved session may be the problem; the next attempt starts clean
+    Serial.printf("TLS %s handshake with %s failed (-0x%04x, verify 0x%x)\n", name, host, -ret,
+                  mbedtls_ssl_get_verify_result(&ssl));
+    have_session = false;
+    stop();
+    return 0;
+  }
+
+  uint32_t elapsed = micros() - handshake_start;
+  TlsHandshakeKind kind = certificate_seen ? TLS_HANDSHAKE_FULL : TLS_HANDSHAKE_RESUMED;
+  handshakes[kind]++;
+  handshake_us[kind] += elapsed;
+  tls_up = true;
+  save_session();
+
+  Serial.printf("TLS %s %s handshake in %lu ms (%s)\n", name, tls_handshake_names[kind],
+                (unsigned long)(elapsed / 1000), mbedtls_ssl_get_ciphersuite(&ssl));
+  return 1;
+}
+
+size_t TlsSessionClient::write(uint8_t data) {
+  return write(&data, 1);
+}
+
+/**
+ * Encrypt and send, waiting up to TLS_HANDSHAKE_TIMEOUT_MS for socket space
+ */
+size_t TlsSessionClient::write(const uint8_t *buf, size_t size) {
+  if (!tls_up) {
+    return 0;
+  }
+
+  size_t sent = 0;
+  unsigned long started = millis();
+  while (sent < size) {
+    int ret = mbedtls_ssl_write(&ssl, buf + sent, size - sent);
+    if (ret > 0) {
+      sent += ret;
+      continue;
+    }
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      stop();
+      break;
+    }
+    if (millis() - started > TLS_HANDSHAKE_TIMEOUT_MS) {
+      break;
+    }
+    delay(1);
+  }
+  return sent;
+}
+
+/**
+ * Decrypted bytes ready to read, pulling in a record if one has arrived
+ */
+int TlsSessionClient::available() {
+  if (!tls_up) {
+    return 0;
+  }
+
+  int pending = peeked >= 0 ? 1 : 0;
+  if (mbedtls_ssl_get_bytes_avail(&ssl) == 0) {
+    int ret = mbedtls_ssl_read(&ssl, nullptr, 0);
+    if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      stop();
+      return pending;
+    }
+  }
+  return mbedtls_ssl_get_bytes_avail(&ssl) + pending;
+}
+
+int TlsSessionClient::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+/**
+ * Read decrypted bytes without blocking
+ * @return Bytes read, or -1 when nothing is available
+ */
+int TlsSessionClient::read(uint8_t *buf, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+
+  size_t offset = 0;
+  if (peeked >= 0) {
+    buf[offset++] = (uint8_t)peeked;
+    peeked = -1;
+  }
+  if (!tls_up || offset == size) {
+    return offset > 0 ? (int)offset : -1;
+  }
+
+  int ret = mbedtls_ssl_read(&ssl, buf + offset, size - offset);
+  if (ret > 0) {
+    return ret + offset;
+  }
+  if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    // Close notify, end of stream or a fatal error
+    stop();
+  }
+  return offset > 0 ? (int)offset : -1;
+}
+
+int TlsSessionClient::peek() {
+  if (peeked < 0) {
+    uint8_t c;
+    if (read(&c, 1) == 1) {
+      peeked = c;
+    }
+  }
+  return peeked;
+}
+
+/**
+ * Nothing to flush: writes go out record by record, and WiFiClient::flush
+ * would discard raw ciphertext from under mbedtls
+ */
+void TlsSessionClient::flush() {
+}
+
+void TlsSessionClient::stop() {
+  if (tls_up) {
+    mbedtls_ssl_close_notify(&ssl);
+  }
+  tls_up = false;
+  peeked = -1;
+  mbedtls_ssl_free(&ssl);
+  mbedtls_ssl_init(&ssl);
+  net.fd = -1;
+  WiFiClient::stop();
+}
+
+uint8_t TlsSessionClient::connected() {
+  if (!tls_up) {
+    return 0;
+  }
+  if (!WiFiClient::connected()) {
+    tls_up = false;
+    return 0;
+  }
+  return 1;
+}
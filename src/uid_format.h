@@ -0,0 +1,33 @@
+/**
+ * Card UID Text
+ * The one spelling of a UID used everywhere a card is compared: scans,
+ * both roster formats, roster deltas and the baked roster
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <MFRC522.h>
+
+// "XX " per UID byte (10 bytes max) plus terminator
+#define UID_TEXT_SIZE 32
+
+/**
+ * Format a card UID as space-separated uppercase hex, e.g. "0A 1B 2C 3D"
+ * @param uid UID read from the card
+ * @param out Output buffer
+ * @param out_size Output buffer size (UID_TEXT_SIZE fits any UID)
+ */
+void format_uid(const MFRC522::Uid &uid, char *out, size_t out_size) {
+  static const char hex_digits[] = "0123456789ABCDEF";
+  size_t pos = 0;
+
+  for (byte i = 0; i < uid.size && pos + (i > 0 ? 4 : 3) <= out_size; i++) {
+    if (i > 0) {
+      out[pos++] = ' ';
+    }
+    out[pos++] = hex_digits[uid.uidByte[i] >> 4];
+    out[pos++] = hex_digits[uid.uidByte[i] & 0x0F];
+  }
+  out[pos] = '\0';
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Struct to hold individual user info
+struct UserInfo {
+  String uid;
+  String dlsu_id;
+  String name;
+  String discord_username;
+};
+
+// Longest member field the scan path keeps; longer text is cut for display and alerts
+#define MEMBER_FIELD_SIZE 64
+
+// A member's details copied out of the roster for one scan, without touching the heap
+struct MemberCard {
+  char dlsu_id[MEMBER_FIELD_SIZE];
+  char name[MEMBER_FIELD_SIZE];
+  char discord_username[MEMBER_FIELD_SIZE];
+};
+
+/**
+ * Fill a member card from roster fields
+ * @param card Card to fill
+ * @param dlsu_id Student ID
+ * @param name Full name
+ * @param discord_username Discord username
+ */
+void member_card_fill(MemberCard &card, const char *dlsu_id, const char *name, const char *discord_username) {
+  snprintf(card.dlsu_id, sizeof(card.dlsu_id), "%s", dlsu_id);
+  snprintf(card.name, sizeof(card.name), "%s", name);
+  snprintf(card.discord_username, sizeof(card.discord_username), "%s", discord_username);
+}
@@ -0,0 +1,289 @@
+/**
+ * WiFi Link
+ * Fast association from a cached channel and BSSID, and a background reconnect task
+ *
+ * The AP channel, BSSID and last DHCP lease are kept in RTC memory (soft resets)
+ * and NVS (power cycles), each checked by magic and CRC before use. With a cached AP, WiFi.begin() skips the full scan; if
+ * that fails within WIFI_FAST_TIMEOUT_MS the normal scan path is used.
+ * Set -D WIFI_STATIC_IP='"a.b.c.d"' (plus WIFI_GATEWAY, WIFI_SUBNET, WIFI_DNS) to
+ * skip DHCP, or -D WIFI_REUSE_LEASE=1 to reuse the cached lease as a static address
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+#include <http_policy.h>
+#include <stall_monitor.h>
+
+#ifndef WIFI_FAST_TIMEOUT_MS
+#define WIFI_FAST_TIMEOUT_MS 4000
+#endif
+
+#ifndef WIFI_CONNECT_TIMEOUT_MS
+#define WIFI_CONNECT_TIMEOUT_MS 15000
+#endif
+
+// Only safe when the router reserves the address for this gate
+#ifndef WIFI_REUSE_LEASE
+#define WIFI_REUSE_LEASE 0
+#endif
+
+#ifndef WIFI_SUBNET
+#define WIFI_SUBNET "255.255.255.0"
+#endif
+
+#define WIFI_CACHE_MAGIC 0x57494649
+
+// Reconnect backoff; only the backoff fields are used
+const RequestPolicy wifi_policy = {0, 0, 500, 15000};
+
+// Last known access point and lease
+struct WifiCache {
+  uint32_t magic;
+  int32_t channel;
+  uint8_t bssid[6];
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint32_t crc;
+};
+
+// Link history, read by the metrics server
+struct WifiLinkStats {
+  volatile uint32_t outages;
+  volatile uint32_t reconnects;
+  volatile uint32_t fast_connects;
+  volatile uint32_t last_connect_ms;
+  volatile uint32_t last_outage_ms;
+  volatile uint32_t outage_total_ms;
+  volatile uint8_t last_reason;
+};
+
+static RTC_NOINIT_ATTR WifiCache wifi_cache;
+static WifiLinkStats wifi_stats = {0, 0, 0, 0, 0, 0, 0};
+static const char *wifi_ssid_name = nullptr;
+static const char *wifi_passphrase = nullptr;
+static TaskHandle_t wifi_task = nullptr;
+static volatile unsigned long wifi_down_at = 0;
+static volatile bool wifi_was_up = false;
+static volatile bool wifi_cache_dirty = false;
+
+/**
+ * CRC-32 of everything in the cache before the crc field
+ */
+uint32_t wifi_cache_crc(const WifiCache &cache) {
+  return esp_rom_crc32_le(0, (const uint8_t *)&cache, offsetof(WifiCache, crc));
+}
+
+bool wifi_cache_valid(const WifiCache &cache) {
+  return cache.magic == WIFI_CACHE_MAGIC && cache.crc == wifi_cache_crc(cache);
+}
+
+/**
+ * Keep the cache RTC memory held through a soft reset, else load it from NVS
+ * RTC memory is not initialised at all and holds garbage after power-on
+ */
+void wifi_cache_load() {
+  if (esp_reset_reason() != ESP_RST_POWERON && wifi_cache_valid(wifi_cache)) {
+    return;
+  }
+  Preferences prefs;
+  prefs.begin("wifi", true);
+  if (prefs.getBytesLength("cache") != sizeof(wifi_cache) ||
+      prefs.getBytes("cache", &wifi_cache, sizeof(wifi_cache)) != sizeof(wifi_cache) ||
+      !wifi_cache_valid(wifi_cache)) {
+    memset(&wifi_cache, 0, sizeof(wifi_cache));
+  }
+  prefs.end();
+}
+
+/**
+ * Record the current AP and lease; NVS is only written when they changed
+ */
+void wifi_cache_save() {
+  WifiCache current;
+  memset(&current, 0, sizeof(current));
+  current.magic = WIFI_CACHE_MAGIC;
+  current.channel = WiFi.channel();
+  memcpy(current.bssid, WiFi.BSSID(), sizeof(current.bssid));
+  current.ip = WiFi.localIP();
+  current.gateway = WiFi.gatewayIP();
+  current.subnet = WiFi.subnetMask();
+  current.dns = WiFi.dnsIP();
+  current.crc = wifi_cache_crc(current);
+
+  bool changed = memcmp(&current, &wifi_cache, sizeof(current)) != 0;
+  wifi_cache = current;
+  if (changed) {
+    Preferences prefs;
+    prefs.begin("wifi", false);
+    prefs.putBytes("cache", &wifi_cache, sizeof(wifi_cache));
+    prefs.end();
+    Serial.printf("WiFi cache updated: channel %d, IP %s\n", wifi_cache.channel, WiFi.localIP().toString().c_str());
+  }
+}
+
+/**
+ * Apply static addressing, if configured
+ * @param fast Whether this is the cached-AP attempt (the only one that reuses a lease)
+ */
+void wifi_apply_addressing(bool fast) {
+#ifdef WIFI_STATIC_IP
+  IPAddress ip, gateway, subnet, dns;
+  ip.fromString(WIFI_STATIC_IP);
+  gateway.fromString(WIFI_GATEWAY);
+  subnet.fromString(WIFI_SUBNET);
+#ifdef WIFI_DNS
+  dns.fromString(WIFI_DNS);
+#else
+  dns = gateway;
+#endif
+  WiFi.config(ip, gateway, subnet, dns);
+#else
+  if (WIFI_REUSE_LEASE && fast && wifi_cache.ip != 0) {
+    WiFi.config(IPAddress(wifi_cache.ip), IPAddress(wifi_cache.gateway), IPAddress(wifi_cache.subnet),
+                IPAddress(wifi_cache.dns));
+  } else {
+    WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+  }
+#endif
+}
+
+/**
+ * Wait for an IP address
+ * @param timeout_ms How long to wait
+ * @return true once connected
+ */
+bool wifi_wait(unsigned long timeout_ms) {
+  unsigned long started = millis();
+  while (WiFi.status() != WL_CONNECTED && millis() - started < timeout_ms) {
+    delay(50);
+  }
+  return WiFi.status() == WL_CONNECTED;
+}
+
+/**
+ * Associate once: the cached AP first, then a full scan
+ * @param timeout_ms Budget for the full-scan attempt
+ * @return true once connected
+ */
+bool wifi_associate(unsigned long timeout_ms) {
+  unsigned long started = millis();
+
+  if (wifi_cache.magic == WIFI_CACHE_MAGIC && wifi_cache.channel > 0) {
+    bool connected;
+    {
+      STALL_SCOPE_LIMIT("wifi_fast_connect", WIFI_FAST_TIMEOUT_MS);
+      wifi_apply_addressing(true);
+      WiFi.begin(wifi_ssid_name, wifi_passphrase, wifi_cache.channel, wifi_cache.bssid);
+      connected = wifi_wait(WIFI_FAST_TIMEOUT_MS);
+    }
+    if (connected) {
+      wifi_stats.fast_connects++;
+      wifi_stats.last_connect_ms = millis() - started;
+      Serial.printf("WiFi connected via cached AP in %lu ms\n", millis() - started);
+      return true;
+    }
+    Serial.println("Cached AP did not answer, scanning");
+    WiFi.disconnect();
+  }
+
+  bool connected;
+  {
+    STALL_SCOPE_LIMIT("wifi_scan_connect", WIFI_CONNECT_TIMEOUT_MS);
+    wifi_apply_addressing(false);
+    WiFi.begin(wifi_ssid_name, wifi_passphrase);
+    connected = wifi_wait(timeout_ms);
+  }
+  if (connected) {
+    wifi_stats.last_connect_ms = millis() - started;
+    Serial.printf("WiFi connected via scan in %lu ms\n", millis() - started);
+    return true;
+  }
+  WiFi.disconnect();
+  return false;
+}
+
+/**
+ * WiFi event handler, runs on the Arduino event task and never blocks
+ */
+void wifi_on_event(arduino_event_id_t event, arduino_event_info_t info) {
+  if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED) {
+    wifi_stats.last_reason = info.wifi_sta_disconnected.reason;
+    // Failed attempts before the first connect are not outages
+    if (wifi_was_up && wifi_down_at == 0) {
+      wifi_down_at = millis() | 1;
+      wifi_stats.outages++;
+      Serial.printf("WiFi lost (reason %u)\n", wifi_stats.last_reason);
+    }
+  } else if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+    if (wifi_down_at != 0) {
+      uint32_t outage = millis() - wifi_down_at;
+      wifi_down_at = 0;
+      wifi_stats.last_outage_ms = outage;
+      wifi_stats.outage_total_ms += outage;
+      Serial.printf("WiFi back after %u ms outage\n", outage);
+    }
+    wifi_was_up = true;
+    wifi_cache_dirty = true;
+  } else {
+    return;
+  }
+  if (wifi_task != nullptr) {
+    xTaskNotifyGive(wifi_task);
+  }
+}
+
+/**
+ * Background task: connects at boot, reconnects after a drop and saves the cache after a new lease
+ */
+void wifi_link_task(void *arg) {
+  bool ever_connected = false;
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    uint8_t attempt = 0;
+    while (WiFi.status() != WL_CONNECTED) {
+      attempt++;
+      if (wifi_associate(WIFI_CONNECT_TIMEOUT_MS)) {
+        if (ever_connected) {
+          wifi_stats.reconnects++;
+        }
+        break;
+      }
+      unsigned long wait = policy_backoff(wifi_policy, min(attempt, (uint8_t)8));
+      Serial.printf("WiFi reconnect attempt %u failed, next in %lu ms\n", attempt, wait);
+      vTaskDelay(pdMS_TO_TICKS(wait));
+    }
+
+    ever_connected = ever_connected || WiFi.status() == WL_CONNECTED;
+    if (wifi_cache_dirty && WiFi.status() == WL_CONNECTED) {
+      wifi_cache_dirty = false;
+      wifi_cache_save();
+    }
+  }
+}
+
+/**
+ * Start the link task and return at once; association runs on core 0 while boot continues
+ * @param ssid Network name
+ * @param passphrase Network password
+ */
+void wifi_link_begin(const char *ssid, const char *passphrase) {
+  wifi_ssid_name = ssid;
+  wifi_passphrase = passphrase;
+
+  WiFi.mode(WIFI_STA);
+  WiFi.persistent(false);
+  WiFi.setAutoReconnect(false);
+  wifi_cache_load();
+
+  WiFi.onEvent(wifi_on_event);
+  xTaskCreatePinnedToCore(wifi_link_task, "wifi_link", 4096, nullptr, tskIDLE_PRIORITY + 2, &wifi_task, 0);
+  xTaskNotifyGive(wifi_task);
+}
@@ -0,0 +1,142 @@
+/**
+ * Host Arduino Stand-in
+ * Just enough of the Arduino core for the firmware's pure headers to build
+ * and run under the native test environment
+ */
+
+#pragma once
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+
+// Arduino String on std::string, with the members the firmware headers use
+class String {
+ public:
+  String(const char *text = "") : text_(text != nullptr ? text : "") {}
+  String(const std::string &text) : text_(text) {}
+  String(int value) : text_(std::to_string(value)) {}
+  String(unsigned int value) : text_(std::to_string(value)) {}
+  String(long value) : text_(std::to_string(value)) {}
+  String(unsigned long value) : text_(std::to_string(value)) {}
+
+  const char *c_str() const {
+    return text_.c_str();
+  }
+  unsigned int length() const {
+    return text_.size();
+  }
+  bool reserve(unsigned int size) {
+    text_.reserve(size);
+    return true;
+  }
+  bool startsWith(const String &prefix) const {
+    return text_.compare(0, prefix.text_.size(), prefix.text_) == 0;
+  }
+  int indexOf(const char *text) const {
+    size_t found = text_.find(text);
+    return found == std::string::npos ? -1 : (int)found;
+  }
+  String substring(unsigned int from, unsigned int to = UINT32_MAX) const {
+    from = min(from, length());
+    to = min(max(to, from), length());
+    return String(text_.substr(from, to - from));
+  }
+  char operator[](unsigned int index) const {
+    return index < text_.size() ? text_[index] : '\0';
+  }
+  String &operator+=(const String &other) {
+    text_ += other.text_;
+    return *this;
+  }
+  friend String operator+(const String &left, const String &right) {
+    return String(left.text_ + right.text_);
+  }
+  friend bool operator==(const String &left, const String &right) {
+    return left.text_ == right.text_;
+  }
+  friend bool operator!=(const String &left, const String &right) {
+    return left.text_ != right.text_;
+  }
+
+ private:
+  std::string text_;
+};
+
+// Serial output goes to stdout
+struct HostSerial {
+  void printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+  }
+  void print(const char *text) {
+    fputs(text, stdout);
+  }
+  void println(const char *text) {
+    puts(text);
+  }
+  void println(const String &text) {
+    puts(text.c_str());
+  }
+};
+
+static HostSerial Serial __attribute__((unused));
+
+// Heap figures are not meaningful on the host; fixed values keep the reporting code paths alive
+struct HostEsp {
+  uint32_t getFreeHeap() {
+    return 200000;
+  }
+  uint32_t getMaxAllocHeap() {
+    return 110000;
+  }
+};
+
+static HostEsp ESP __attribute__((unused));
+
+static inline unsigned long micros() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static inline unsigned long millis() {
+  return micros() / 1000;
+}
+
+// Whether the emulated board has PSRAM; tests switch it
+static bool host_psram __attribute__((unused)) = false;
+
+static inline bool psramFound() {
+  return host_psram;
+}
+
+// FreeRTOS mutexes: the host tests run on one thread, so they are always free
+typedef void *SemaphoreHandle_t;
+typedef uint32_t TickType_t;
+#define portMAX_DELAY 0xFFFFFFFFu
+#define pdTRUE 1
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+  static int mutex;
+  return &mutex;
+}
+
+static inline int xSemaphoreTake(SemaphoreHandle_t, TickType_t) {
+  return pdTRUE;
+}
+
+static inline int xSemaphoreGive(SemaphoreHandle_t) {
+  return pdTRUE;
+}
@@ -0,0 +1,17 @@
+/**
+ * Host stand-in for the MFRC522 library
+ * Only the UID type, laid out as in the library
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+class MFRC522 {
+ public:
+  typedef struct {
+    byte size;
+    byte uidByte[10];
+    byte sak;
+  } Uid;
+};
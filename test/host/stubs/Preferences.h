@@ -0,0 +1,38 @@
+/**
+ * Host stand-in for the ESP32 Preferences (NVS) library
+ * Values live in memory for the life of the test program
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+
+class Preferences {
+ public:
+  bool begin(const char *name, bool read_only = false) {
+    (void)read_only;
+    name_ = name;
+    return true;
+  }
+  void end() {
+  }
+  uint32_t getUInt(const char *key, uint32_t default_value = 0) {
+    auto found = store().find(name_ + "/" + key);
+    return found != store().end() ? found->second : default_value;
+  }
+  size_t putUInt(const char *key, uint32_t value) {
+    store()[name_ + "/" + key] = value;
+    return sizeof(value);
+  }
+
+  // Everything written so far, shared by every instance like the NVS partition
+  static std::map<std::string, uint32_t> &store() {
+    static std::map<std::string, uint32_t> values;
+    return values;
+  }
+
+ private:
+  std::string name_;
+};
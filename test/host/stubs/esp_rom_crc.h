@@ -0,0 +1,13 @@
+/**
+ * Host stand-in for the ESP32 ROM CRC routines
+ * The ROM crc32_le and zlib's crc32 are the same CRC-32, chained from 0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <zlib.h>
+
+static inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+  return (uint32_t)crc32(crc, buf, len);
+}
@@ -0,0 +1,110 @@
+/**
+ * Host stand-in for the ESP32 ROM miniz header
+ *
+ * With -D HOST_MINIZ=1 and a miniz 1.15 checkout on the include path
+ * (PLATFORMIO_BUILD_FLAGS="-D HOST_MINIZ=1 -I <miniz>"), the real tinfl the
+ * ROM carries is compiled into the test. Otherwise tinfl is emulated on zlib,
+ * including the way miniz 1.15 keeps input it preloaded into its bit buffer
+ * when the deflate data ends: host_tinfl_lookahead of the bytes after the
+ * deflate data are reported as consumed.
+ */
+
+#pragma once
+
+#if HOST_MINIZ
+
+#define MINIZ_NO_STDIO
+#define MINIZ_NO_TIME
+#define MINIZ_NO_ARCHIVE_APIS
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+#include <miniz.c>
+
+// The real tinfl decides its own read-ahead; kept so the tests build either way
+static size_t host_tinfl_lookahead = 0;
+
+#else
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+
+#define TINFL_LZ_DICT_SIZE 32768
+
+enum {
+  TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+  TINFL_FLAG_HAS_MORE_INPUT = 2,
+  TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+  TINFL_FLAG_COMPUTE_ADLER32 = 8
+};
+
+typedef enum {
+  TINFL_STATUS_BAD_PARAM = -3,
+  TINFL_STATUS_ADLER32_MISMATCH = -2,
+  TINFL_STATUS_FAILED = -1,
+  TINFL_STATUS_DONE = 0,
+  TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+  TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+// 0 before the first call, 1 while inflating, 2 once finished, 3 after a failure
+struct tinfl_decompressor {
+  z_stream z;
+  int state;
+};
+
+#define tinfl_init(r) \
+  do {                \
+    (r)->state = 0;   \
+  } while (0)
+
+// Bytes past the end of the deflate data that the emulated tinfl swallows
+static size_t host_tinfl_lookahead = 2;
+
+static inline tinfl_status tinfl_decompress(tinfl_decompressor *r, const uint8_t *in, size_t *in_size,
+                                            uint8_t *out_start, uint8_t *out_next, size_t *out_size,
+                                            uint32_t flags) {
+  (void)out_start;
+  if (r->state >= 2) {
+    *in_size = 0;
+    *out_size = 0;
+    return r->state == 2 ? TINFL_STATUS_DONE : TINFL_STATUS_FAILED;
+  }
+  if (r->state == 0) {
+    memset(&r->z, 0, sizeof(r->z));
+    if (inflateInit2(&r->z, -15) != Z_OK) {
+      return TINFL_STATUS_FAILED;
+    }
+    r->state = 1;
+  }
+
+  r->z.next_in = (Bytef *)in;
+  r->z.avail_in = *in_size;
+  r->z.next_out = out_next;
+  r->z.avail_out = *out_size;
+  int rc = inflate(&r->z, Z_NO_FLUSH);
+  size_t used = *in_size - r->z.avail_in;
+  *out_size -= r->z.avail_out;
+
+  tinfl_status status;
+  if (rc == Z_STREAM_END) {
+    used += r->z.avail_in < host_tinfl_lookahead ? r->z.avail_in : host_tinfl_lookahead;
+    status = TINFL_STATUS_DONE;
+  } else if (rc == Z_OK || rc == Z_BUF_ERROR) {
+    if (r->z.avail_out == 0) {
+      status = TINFL_STATUS_HAS_MORE_OUTPUT;
+    } else {
+      status = (flags & TINFL_FLAG_HAS_MORE_INPUT) ? TINFL_STATUS_NEEDS_MORE_INPUT : TINFL_STATUS_FAILED;
+    }
+  } else {
+    status = TINFL_STATUS_FAILED;
+  }
+  *in_size = used;
+  if (status == TINFL_STATUS_DONE || status == TINFL_STATUS_FAILED) {
+    inflateEnd(&r->z);
+    r->state = status == TINFL_STATUS_DONE ? 2 : 3;
+  }
+  return status;
+}
+
+#endif
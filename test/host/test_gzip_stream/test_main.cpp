@@ -0,0 +1,168 @@
+/**
+ * Gzip Stream host tests
+ * Inflates gzip members laid out like Apps Script's Utilities.gzip() output
+ * through gzip_next() and gzip_end(), including the trailer check after tinfl
+ * has swallowed input past the end of the deflate data
+ */
+
+#include <unity.h>
+#include <vector>
+#include <gzip_stream.h>
+
+// Compressed bytes handed to gzip_begin() one at a time
+struct MemorySource {
+  const std::vector<uint8_t> *data;
+  size_t pos;
+};
+
+int memory_source_next(void *context) {
+  MemorySource *source = (MemorySource *)context;
+  return source->pos < source->data->size() ? (*source->data)[source->pos++] : -1;
+}
+
+/**
+ * Roster-like payload: repeated record structure with varying fields, or noise
+ * @param size Bytes to produce
+ * @param noise true for incompressible data (stored deflate blocks)
+ */
+std::vector<uint8_t> sample_payload(size_t size, bool noise) {
+  std::vector<uint8_t> data(size);
+  uint32_t state = 2463534242u;
+  for (size_t i = 0; i < size; i++) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    if (noise) {
+      data[i] = state;
+    } else {
+      const char record[] = "\x04\x0A\x1B\x2C\x3D\x08" "12012345\x0B" "Member Name\x0A" "member";
+      data[i] = (i % 7 == 3) ? '0' + state % 10 : record[i % (sizeof(record) - 1)];
+    }
+  }
+  return data;
+}
+
+/**
+ * gzip member the way java.util.zip.GZIPOutputStream (behind Utilities.gzip) writes it:
+ * 10-byte header, OS 0, optional file name, raw deflate, CRC-32 and length
+ */
+std::vector<uint8_t> gzip_member(const std::vector<uint8_t> &payload, const char *name) {
+  std::vector<uint8_t> out = {0x1F, 0x8B, 8, (uint8_t)(name ? GZIP_FLAG_NAME : 0), 0, 0, 0, 0, 0, 0};
+  if (name) {
+    out.insert(out.end(), name, name + strlen(name) + 1);
+  }
+
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+  std::vector<uint8_t> deflated(deflateBound(&z, payload.size()) + 16);
+  z.next_in = (Bytef *)payload.data();
+  z.avail_in = payload.size();
+  z.next_out = deflated.data();
+  z.avail_out = deflated.size();
+  TEST_ASSERT_EQUAL(Z_STREAM_END, deflate(&z, Z_FINISH));
+  out.insert(out.end(), deflated.begin(), deflated.begin() + z.total_out);
+  deflateEnd(&z);
+
+  uint32_t crc = crc32(0, payload.data(), payload.size());
+  uint32_t size = payload.size();
+  for (uint32_t word : {crc, size}) {
+    for (int shift = 0; shift < 32; shift += 8) {
+      out.push_back(word >> shift);
+    }
+  }
+  return out;
+}
+
+/**
+ * Inflate a member, reading at most `read_limit` bytes before gzip_end()
+ * @return gzip_end() result; the bytes read are compared with the payload
+ */
+bool inflate_member(const std::vector<uint8_t> &member, const std::vector<uint8_t> &payload, size_t read_limit) {
+  MemorySource source = {&member, 0};
+  GzipStream gz;
+  TEST_ASSERT_TRUE(gzip_begin(gz, memory_source_next, &source));
+  size_t read = 0;
+  int c;
+  while (read < read_limit && (c = gzip_next(&gz)) >= 0) {
+    TEST_ASSERT_LESS_THAN(payload.size(), read);
+    TEST_ASSERT_EQUAL_UINT8(payload[read], c);
+    read++;
+  }
+  if (read_limit >= payload.size()) {
+    TEST_ASSERT_EQUAL(payload.size(), read);
+  }
+  bool ok = gzip_end(gz);
+  TEST_ASSERT_EQUAL(member.size(), gz.compressed);
+  return ok;
+}
+
+void setUp() {
+  host_tinfl_lookahead = 2;
+}
+
+void tearDown() {
+}
+
+void test_inflates_and_checks_trailer() {
+  const size_t sizes[] = {0, 1, 100, 5000, 100000};
+  for (size_t lookahead : {0, 2, 4, 8}) {
+    host_tinfl_lookahead = lookahead;
+    for (size_t size : sizes) {
+      std::vector<uint8_t> payload = sample_payload(size, false);
+      TEST_ASSERT_TRUE(inflate_member(gzip_member(payload, nullptr), payload, SIZE_MAX));
+    }
+  }
+}
+
+void test_stored_blocks() {
+  std::vector<uint8_t> payload = sample_payload(40000, true);
+  TEST_ASSERT_TRUE(inflate_member(gzip_member(payload, nullptr), payload, SIZE_MAX));
+}
+
+void test_file_name_header() {
+  std::vector<uint8_t> payload = sample_payload(3000, false);
+  TEST_ASSERT_TRUE(inflate_member(gzip_member(payload, "roster.bin"), payload, SIZE_MAX));
+}
+
+void test_partial_read_still_checked() {
+  std::vector<uint8_t> payload = sample_payload(60000, false);
+  std::vector<uint8_t> member = gzip_member(payload, nullptr);
+  TEST_ASSERT_TRUE(inflate_member(member, payload, 1000));
+
+  member[member.size() - 8] ^= 0x01;
+  TEST_ASSERT_FALSE(inflate_member(member, payload, 1000));
+}
+
+void test_bad_crc_rejected() {
+  std::vector<uint8_t> payload = sample_payload(5000, false);
+  std::vector<uint8_t> member = gzip_member(payload, nullptr);
+  member[member.size() - 6] ^= 0x40;
+  TEST_ASSERT_FALSE(inflate_member(member, payload, SIZE_MAX));
+}
+
+void test_bad_length_rejected() {
+  std::vector<uint8_t> payload = sample_payload(5000, false);
+  std::vector<uint8_t> member = gzip_member(payload, nullptr);
+  member[member.size() - 4] ^= 0x01;
+  TEST_ASSERT_FALSE(inflate_member(member, payload, SIZE_MAX));
+}
+
+void test_truncated_trailer_rejected() {
+  std::vector<uint8_t> payload = sample_payload(5000, false);
+  std::vector<uint8_t> member = gzip_member(payload, nullptr);
+  member.resize(member.size() - 3);
+  TEST_ASSERT_FALSE(inflate_member(member, payload, SIZE_MAX));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_inflates_and_checks_trailer);
+  RUN_TEST(test_stored_blocks);
+  RUN_TEST(test_file_name_header);
+  RUN_TEST(test_partial_read_still_checked);
+  RUN_TEST(test_bad_crc_rejected);
+  RUN_TEST(test_bad_length_rejected);
+  RUN_TEST(test_truncated_trailer_rejected);
+  return UNITY_END();
+}
@@ -0,0 +1,183 @@
+/**
+ * JSON Arena host tests
+ * Drives JsonArena through the ArduinoJson Allocator interface, then parses a
+ * roster document in it with the ArduinoJson the firmware builds against
+ */
+
+#include <unity.h>
+#include <string>
+#include <ArduinoJson.h>
+#include <json_arena.h>
+
+bool inside(const void *ptr, const uint8_t *block, size_t capacity) {
+  return (const uint8_t *)ptr >= block && (const uint8_t *)ptr < block + capacity;
+}
+
+// Synthetic roster in the doGet JSON shape
+std::string roster_json(int members) {
+  std::string roster = "[";
+  for (int i = 0; i < members; i++) {
+    char entry[160];
+    snprintf(entry, sizeof(entry),
+             "%s{\"uid\":\"EA 00 00 %02X\",\"dlsu_id\":\"12%06d\",\"name\":\"Member %d\","
+             "\"discord_username\":\"member%d\",\"timestamp\":\"08:00\"}",
+             i > 0 ? "," : "", i, i, i, i);
+    roster += entry;
+  }
+  return roster + "]";
+}
+
+// Parse a roster through the shared arena like a sync does
+void parse_roster(const std::string &roster, int members) {
+  JsonArenaLease arena(json_arena_roster_size());
+  JsonDocument doc(arena.allocator());
+  TEST_ASSERT_FALSE(deserializeJson(doc, roster.c_str()));
+  TEST_ASSERT_EQUAL(members, doc.as<JsonArray>().size());
+  TEST_ASSERT_EQUAL_STRING("Member 7", doc[7]["name"].as<const char *>());
+  TEST_ASSERT_EQUAL_STRING("EA 00 00 31", doc[49]["uid"].as<const char *>());
+}
+
+void setUp() {
+  host_psram = false;
+  json_arena_stats = {0, 0, 0, 0, 0, 0, false};
+  Preferences::store().clear();
+}
+
+void tearDown() {
+}
+
+void test_allocations_are_aligned_and_reused_after_reset() {
+  JsonArena arena;
+  arena.reserve(JSON_ARENA_MIN_SIZE);
+  ArduinoJson::Allocator &allocator = arena;
+
+  void *first = allocator.allocate(13);
+  void *second = allocator.allocate(1);
+  TEST_ASSERT_EQUAL(0, (uintptr_t)first % 8);
+  TEST_ASSERT_EQUAL(0, (uintptr_t)second % 8);
+  TEST_ASSERT_EQUAL(16 + JSON_ARENA_HEADER, (uint8_t *)second - (uint8_t *)first);
+  memset(first, 0xAA, 13);
+
+  TEST_ASSERT_EQUAL(16 + JSON_ARENA_HEADER + 8 + JSON_ARENA_HEADER, arena.reset());
+  TEST_ASSERT_FALSE(arena.spilled());
+  TEST_ASSERT_EQUAL_PTR(first, allocator.allocate(100));
+}
+
+void test_newest_block_is_given_back() {
+  JsonArena arena;
+  arena.reserve(JSON_ARENA_MIN_SIZE);
+  ArduinoJson::Allocator &allocator = arena;
+
+  allocator.allocate(32);
+  void *last = allocator.allocate(64);
+  allocator.deallocate(last);
+  TEST_ASSERT_EQUAL_PTR(last, allocator.allocate(48));
+}
+
+void test_newest_block_grows_in_place() {
+  JsonArena arena;
+  arena.reserve(JSON_ARENA_MIN_SIZE);
+  ArduinoJson::Allocator &allocator = arena;
+
+  char *text = (char *)allocator.allocate(8);
+  strcpy(text, "member");
+  TEST_ASSERT_EQUAL_PTR(text, allocator.reallocate(text, 200));
+  TEST_ASSERT_EQUAL_STRING("member", text);
+  TEST_ASSERT_EQUAL_PTR(text, allocator.reallocate(text, 16));
+}
+
+void test_older_block_moves_when_grown() {
+  JsonArena arena;
+  arena.reserve(JSON_ARENA_MIN_SIZE);
+  ArduinoJson::Allocator &allocator = arena;
+
+  char *text = (char *)allocator.allocate(8);
+  strcpy(text, "member");
+  void *newer = allocator.allocate(8);
+  char *moved = (char *)allocator.reallocate(text, 64);
+  TEST_ASSERT_TRUE(moved > (char *)newer);
+  TEST_ASSERT_EQUAL_STRING("member", moved);
+}
+
+void test_overflow_spills_to_the_heap() {
+  JsonArena arena;
+  arena.reserve(JSON_ARENA_MIN_SIZE);
+  ArduinoJson::Allocator &allocator = arena;
+
+  uint8_t *block = (uint8_t *)allocator.allocate(1);
+  void *big = allocator.allocate(JSON_ARENA_MIN_SIZE * 2);
+  TEST_ASSERT_NOT_NULL(big);
+  TEST_ASSERT_FALSE(inside(big, block, JSON_ARENA_MIN_SIZE));
+  big = allocator.reallocate(big, JSON_ARENA_MIN_SIZE * 3);
+  TEST_ASSERT_NOT_NULL(big);
+  allocator.deallocate(big);
+
+  TEST_ASSERT_GREATER_OR_EQUAL(JSON_ARENA_MIN_SIZE * 3, arena.reset());
+  TEST_ASSERT_TRUE(arena.spilled());
+}
+
+void test_reserve_is_capped_without_psram() {
+  JsonArena arena;
+  arena.reserve(10);
+  TEST_ASSERT_EQUAL(JSON_ARENA_MIN_SIZE, json_arena_stats.capacity);
+  arena.reserve(JSON_ARENA_MAX_SIZE * 4);
+  TEST_ASSERT_EQUAL(JSON_ARENA_MAX_SIZE, json_arena_stats.capacity);
+  TEST_ASSERT_FALSE(json_arena_stats.psram);
+}
+
+void test_reserve_uses_psram_when_present() {
+  host_psram = true;
+  JsonArena arena;
+  arena.reserve(JSON_ARENA_MAX_SIZE * 4);
+  TEST_ASSERT_EQUAL(JSON_ARENA_MAX_SIZE * 4, json_arena_stats.capacity);
+  TEST_ASSERT_TRUE(json_arena_stats.psram);
+}
+
+void test_peak_is_kept_for_the_next_boot() {
+  json_arena_begin();
+  ArduinoJson::Allocator *allocator = json_arena_acquire(json_arena_roster_size());
+  allocator->deallocate(allocator->allocate(20000));
+  json_arena_release();
+  TEST_ASSERT_GREATER_OR_EQUAL(20000, json_arena_stats.peak);
+  uint32_t peak = json_arena_stats.peak;
+
+  json_arena_stats.peak = 0;
+  json_arena_begin();
+  TEST_ASSERT_EQUAL(peak, json_arena_stats.peak);
+}
+
+void test_roster_document_parses_in_the_arena() {
+  std::string roster = roster_json(200);
+  json_arena_begin();
+  parse_roster(roster, 200);
+  TEST_ASSERT_GREATER_THAN(0, json_arena_stats.last_peak);
+
+  // The first parse may outgrow the block; the next one gets a block that fits, kept for the syncs after it
+  parse_roster(roster, 200);
+  uint32_t spills = json_arena_stats.spills;
+  uint32_t resizes = json_arena_stats.resizes;
+  parse_roster(roster, 200);
+  TEST_ASSERT_EQUAL(spills, json_arena_stats.spills);
+  TEST_ASSERT_EQUAL(resizes, json_arena_stats.resizes);
+  TEST_ASSERT_GREATER_OR_EQUAL(json_arena_stats.last_peak, json_arena_stats.capacity);
+
+  // A delta parses in the same block
+  uint32_t capacity = json_arena_stats.capacity;
+  { JsonArenaLease delta; }
+  TEST_ASSERT_EQUAL(capacity, json_arena_stats.capacity);
+  TEST_ASSERT_EQUAL(resizes, json_arena_stats.resizes);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_allocations_are_aligned_and_reused_after_reset);
+  RUN_TEST(test_newest_block_is_given_back);
+  RUN_TEST(test_newest_block_grows_in_place);
+  RUN_TEST(test_older_block_moves_when_grown);
+  RUN_TEST(test_overflow_spills_to_the_heap);
+  RUN_TEST(test_reserve_is_capped_without_psram);
+  RUN_TEST(test_reserve_uses_psram_when_present);
+  RUN_TEST(test_peak_is_kept_for_the_next_boot);
+  RUN_TEST(test_roster_document_parses_in_the_arena);
+  return UNITY_END();
+}
@@ -0,0 +1,214 @@
+/**
+ * Binary Roster host tests
+ * Encodes rosters the way convertToBinary() in app_script.txt does, plain and
+ * gzipped, and decodes them through binaryToHashmap()
+ */
+
+#include <unity.h>
+#include <string>
+#include <vector>
+#include <roster_binary.h>
+
+struct Member {
+  std::vector<uint8_t> uid;
+  const char *dlsu_id;
+  const char *name;
+  const char *discord_username;
+};
+
+const std::vector<Member> sample_roster = {
+  {{0x0A, 0x1B, 0x2C, 0x3D}, "12012345", "Juan Dela Cruz", "juandc"},
+  {{0x04, 0xAB, 0xCD, 0xEF, 0x12, 0x80, 0xFF}, "12054321", "Maria Santos", "msantos"},
+  {{0xDE, 0xAD, 0xBE, 0xEF}, "12000001", "Ana Reyes", "anareyes"},
+};
+
+/**
+ * The binary table: "GRB", version, count, then each member
+ * @param members Members to encode
+ * @param count Member count written in the header
+ */
+std::vector<uint8_t> roster_table(const std::vector<Member> &members, size_t count) {
+  std::vector<uint8_t> out = {'G', 'R', 'B', ROSTER_BIN_VERSION, (uint8_t)(count >> 8), (uint8_t)count};
+  for (const Member &member : members) {
+    out.push_back(member.uid.size());
+    out.insert(out.end(), member.uid.begin(), member.uid.end());
+    for (const char *field : {member.dlsu_id, member.name, member.discord_username}) {
+      out.push_back(strlen(field));
+      out.insert(out.end(), field, field + strlen(field));
+    }
+  }
+  return out;
+}
+
+// Utilities.gzip() output: 10-byte header, raw deflate, CRC-32 and length
+std::vector<uint8_t> gzip_bytes(const std::vector<uint8_t> &data) {
+  std::vector<uint8_t> out = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0};
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+  std::vector<uint8_t> deflated(deflateBound(&z, data.size()) + 16);
+  z.next_in = (Bytef *)data.data();
+  z.avail_in = data.size();
+  z.next_out = deflated.data();
+  z.avail_out = deflated.size();
+  TEST_ASSERT_EQUAL(Z_STREAM_END, deflate(&z, Z_FINISH));
+  out.insert(out.end(), deflated.begin(), deflated.begin() + z.total_out);
+  deflateEnd(&z);
+
+  uint32_t crc = crc32(0, data.data(), data.size());
+  uint32_t size = data.size();
+  for (uint32_t word : {crc, size}) {
+    for (int shift = 0; shift < 32; shift += 8) {
+      out.push_back(word >> shift);
+    }
+  }
+  return out;
+}
+
+String base64(const std::vector<uint8_t> &data) {
+  static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string out;
+  for (size_t i = 0; i < data.size(); i += 3) {
+    uint32_t group = data[i] << 16;
+    if (i + 1 < data.size()) group |= data[i + 1] << 8;
+    if (i + 2 < data.size()) group |= data[i + 2];
+    out += alphabet[(group >> 18) & 63];
+    out += alphabet[(group >> 12) & 63];
+    out += i + 1 < data.size() ? alphabet[(group >> 6) & 63] : '=';
+    out += i + 2 < data.size() ? alphabet[group & 63] : '=';
+  }
+  return String(out);
+}
+
+/**
+ * Decode roster text
+ * @return Members decoded; the array is freed here
+ */
+int decode(const String &text, std::vector<UserInfo> *decoded = nullptr) {
+  UserInfo *users = nullptr;
+  int count = -1;
+  binaryToHashmap(text, users, count);
+  TEST_ASSERT_TRUE(count == 0 || users != nullptr);
+  if (decoded != nullptr) {
+    decoded->assign(users, users + count);
+  }
+  delete[] users;
+  return count;
+}
+
+void check_sample(const std::vector<UserInfo> &users) {
+  TEST_ASSERT_EQUAL(3, users.size());
+  TEST_ASSERT_EQUAL_STRING("0A 1B 2C 3D", users[0].uid.c_str());
+  TEST_ASSERT_EQUAL_STRING("12012345", users[0].dlsu_id.c_str());
+  TEST_ASSERT_EQUAL_STRING("Juan Dela Cruz", users[0].name.c_str());
+  TEST_ASSERT_EQUAL_STRING("juandc", users[0].discord_username.c_str());
+  TEST_ASSERT_EQUAL_STRING("04 AB CD EF 12 80 FF", users[1].uid.c_str());
+  TEST_ASSERT_EQUAL_STRING("msantos", users[1].discord_username.c_str());
+  TEST_ASSERT_EQUAL_STRING("DE AD BE EF", users[2].uid.c_str());
+  TEST_ASSERT_EQUAL_STRING("Ana Reyes", users[2].name.c_str());
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_plain_roster_decodes() {
+  String text = base64(roster_table(sample_roster, sample_roster.size()));
+  TEST_ASSERT_TRUE(roster_is_binary(text));
+  std::vector<UserInfo> users;
+  decode(text, &users);
+  check_sample(users);
+}
+
+void test_gzip_roster_decodes() {
+  String text = base64(gzip_bytes(roster_table(sample_roster, sample_roster.size())));
+  TEST_ASSERT_TRUE(roster_is_binary(text));
+  std::vector<UserInfo> users;
+  decode(text, &users);
+  check_sample(users);
+}
+
+void test_large_gzip_roster_decodes() {
+  std::vector<Member> members;
+  std::vector<std::string> names;
+  for (int i = 0; i < 1000; i++) {
+    names.push_back("Member " + std::to_string(i));
+  }
+  for (int i = 0; i < 1000; i++) {
+    members.push_back({{0xEA, (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i}, "12000000", names[i].c_str(), "member"});
+  }
+  std::vector<UserInfo> users;
+  TEST_ASSERT_EQUAL(1000, decode(base64(gzip_bytes(roster_table(members, members.size()))), &users));
+  TEST_ASSERT_EQUAL_STRING("EA 00 03 E7", users[999].uid.c_str());
+  TEST_ASSERT_EQUAL_STRING("Member 999", users[999].name.c_str());
+}
+
+void test_json_is_not_binary() {
+  TEST_ASSERT_FALSE(roster_is_binary("[{\"uid\":\"0A 1B 2C 3D\"}]"));
+}
+
+void test_bad_magic_rejected() {
+  std::vector<uint8_t> table = roster_table(sample_roster, sample_roster.size());
+  table[2] = 'X';
+  TEST_ASSERT_EQUAL(0, decode(base64(table)));
+}
+
+void test_short_table_rejected() {
+  std::vector<uint8_t> table = roster_table(sample_roster, sample_roster.size() + 1);
+  TEST_ASSERT_EQUAL(0, decode(base64(table)));
+  TEST_ASSERT_EQUAL(0, decode(base64(gzip_bytes(table))));
+}
+
+void test_oversized_count_rejected() {
+  std::vector<uint8_t> table = roster_table(sample_roster, 0xFFFF);
+  TEST_ASSERT_EQUAL(0, decode(base64(table)));
+  TEST_ASSERT_EQUAL(0, decode(base64(gzip_bytes(table))));
+}
+
+void test_gzip_declared_size_bounds_count() {
+  std::vector<uint8_t> table = roster_table(sample_roster, sample_roster.size());
+  String text = base64(gzip_bytes(table));
+  TEST_ASSERT_EQUAL(table.size(), gzip_declared_size(text));
+  TEST_ASSERT_EQUAL(0, gzip_declared_size("H4sI"));
+
+  // A trailer claiming too few bytes for the count is refused before decoding
+  std::vector<uint8_t> member = gzip_bytes(table);
+  member[member.size() - 4] = 8;
+  member[member.size() - 3] = 0;
+  TEST_ASSERT_EQUAL(0, decode(base64(member)));
+}
+
+void test_truncated_text_rejected() {
+  String text = base64(roster_table(sample_roster, sample_roster.size()));
+  TEST_ASSERT_EQUAL(0, decode(text.substring(0, text.length() - 12)));
+}
+
+void test_bad_base64_rejected() {
+  String text = base64(roster_table(sample_roster, sample_roster.size()));
+  String broken = text.substring(0, 40) + "*" + text.substring(41);
+  TEST_ASSERT_EQUAL(0, decode(broken));
+}
+
+void test_gzip_bad_crc_rejected() {
+  std::vector<uint8_t> member = gzip_bytes(roster_table(sample_roster, sample_roster.size()));
+  member[member.size() - 8] ^= 0x01;
+  TEST_ASSERT_EQUAL(0, decode(base64(member)));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_plain_roster_decodes);
+  RUN_TEST(test_gzip_roster_decodes);
+  RUN_TEST(test_large_gzip_roster_decodes);
+  RUN_TEST(test_json_is_not_binary);
+  RUN_TEST(test_bad_magic_rejected);
+  RUN_TEST(test_short_table_rejected);
+  RUN_TEST(test_oversized_count_rejected);
+  RUN_TEST(test_gzip_declared_size_bounds_count);
+  RUN_TEST(test_truncated_text_rejected);
+  RUN_TEST(test_bad_base64_rejected);
+  RUN_TEST(test_gzip_bad_crc_rejected);
+  return UNITY_END();
+}
@@ -0,0 +1,61 @@
+/**
+ * UID Format host tests
+ * format_uid() is the spelling every roster format and roster delta is matched against
+ */
+
+#include <unity.h>
+#include <uid_format.h>
+
+MFRC522::Uid make_uid(std::initializer_list<byte> bytes) {
+  MFRC522::Uid uid = {};
+  for (byte b : bytes) {
+    uid.uidByte[uid.size++] = b;
+  }
+  return uid;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_four_byte_uid() {
+  char text[UID_TEXT_SIZE];
+  format_uid(make_uid({0x0A, 0x1B, 0x2C, 0x3D}), text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("0A 1B 2C 3D", text);
+}
+
+void test_seven_byte_uid_is_upper_case() {
+  char text[UID_TEXT_SIZE];
+  format_uid(make_uid({0x04, 0xab, 0xcd, 0xef, 0x12, 0x80, 0xff}), text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("04 AB CD EF 12 80 FF", text);
+}
+
+void test_longest_uid_fits() {
+  char text[UID_TEXT_SIZE];
+  format_uid(make_uid({1, 2, 3, 4, 5, 6, 7, 8, 9, 10}), text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("01 02 03 04 05 06 07 08 09 0A", text);
+}
+
+void test_empty_uid() {
+  char text[UID_TEXT_SIZE] = "stale";
+  format_uid(make_uid({}), text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("", text);
+}
+
+void test_small_buffer_keeps_whole_bytes() {
+  char text[8];
+  format_uid(make_uid({0x0A, 0x1B, 0x2C, 0x3D}), text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("0A 1B", text);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_four_byte_uid);
+  RUN_TEST(test_seven_byte_uid_is_upper_case);
+  RUN_TEST(test_longest_uid_fits);
+  RUN_TEST(test_empty_uid);
+  RUN_TEST(test_small_buffer_keeps_whole_bytes);
+  return UNITY_END();
+}
@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""
+Fleet Load Test
+Several simulated gates posting scans to doPost at the same time
+
+Each round, every gate posts every synthetic card in its own shuffled order,
+all gates released together, so the same card routinely reaches doPost from
+two gates within milliseconds. A fraction of posts is sent twice with the same
+event id, like a gate retrying a lost response. Afterwards doGet ?audit checks
+that nothing was lost or doubled: a card stored P times has ceil(P/2) rows and
+is open (timed in) exactly when P is odd.
+
+Run it against a test copy of the web app, never the production sheet: the
+synthetic cards ("LT<run>-<n>") are denied scans and stay in the Attendance
+sheet. ?audit only answers when the test deployment sets the LOAD_TEST_TOKEN
+script property and --token matches it. Apps Script runs at most 30 executions
+at once per account, so keep --gates well under that.
+  fleet_load_test.py --exec https://script.google.com/macros/s/<test id>/exec --token <secret> --gates 4 --cards 6 --rounds 3
+"""
+
+import argparse
+import json
+import math
+import random
+import statistics
+import sys
+import threading
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+
+def http_request(url, body=None, timeout=60):
+    """GET or POST (when body is given) and return the decoded JSON; urllib follows the echo redirect"""
+    data = body.encode() if body is not None else None
+    request = urllib.request.Request(url, data=data, headers={"Content-Type": "application/json"})
+    with urllib.request.urlopen(request, timeout=timeout) as response:
+        return json.loads(response.read().decode())
+
+
+class Gate(threading.Thread):
+    """One simulated gate: its own device id, boot id and event sequence"""
+
+    def __init__(self, index, args, cards, barrier, results):
+        super().__init__(daemon=True)
+        self.device = "gate-%06x" % (0xF00000 + index)
+        self.boot_id = random.getrandbits(32) | 1
+        self.seq = 0
+        self.args = args
+        self.cards = cards
+        self.barrier = barrier
+        self.results = results
+
+    def post(self, uid, event):
+        body = json.dumps({"uid": uid, "access_granted": False, "reader": 0, "notify": False,
+                           "event": event, "device": self.device}, separators=(",", ":"))
+        started = time.monotonic()
+        try:
+            reply = http_request(self.args.exec_url, body)
+        except (urllib.error.URLError, OSError, ValueError) as error:
+            reply = {"error": str(error)}
+        self.results.append((uid, reply, (time.monotonic() - started) * 1000))
+
+    def run(self):
+        for _ in range(self.args.rounds):
+            order = list(self.cards)
+            random.shuffle(order)
+            self.barrier.wait()
+            for uid in order:
+                self.seq += 1
+                event = "%08x-%u" % (self.boot_id, self.seq)
+                self.post(uid, event)
+                if random.random() < self.args.retry_rate:
+                    self.post(uid, event)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--exec", required=True, dest="exec_url", help="/exec URL of a test deployment")
+    parser.add_argument("--token", required=True, help="LOAD_TEST_TOKEN script property of the test deployment")
+    parser.add_argument("--gates", type=int, default=4, help="simulated gates posting at once")
+    parser.add_argument("--cards", type=int, default=6, help="synthetic cards every gate scans each round")
+    parser.add_argument("--rounds", type=int, default=3)
+    parser.add_argument("--retry-rate", type=float, default=0.2, help="fraction of posts repeated with the same event id")
+    parser.add_argument("--seed", type=int)
+    args = parser.parse_args()
+    random.seed(args.seed)
+
+    run = "LT%05x" % random.getrandbits(20)
+    cards = ["%s-%02d" % (run, n) for n in range(args.cards)]
+    barrier = threading.Barrier(args.gates)
+    results = []
+    gates = [Gate(i, args, cards, barrier, results) for i in range(args.gates)]
+
+    print("Run %s: %d gates x %d cards x %d rounds" % (run, args.gates, args.cards, args.rounds), flush=True)
+    started = time.monotonic()
+    for gate in gates:
+        gate.start()
+    for gate in gates:
+        gate.join()
+    elapsed = time.monotonic() - started
+
+    # Only stored events count towards the expected rows; errors and duplicates were not written
+    stored = {uid: 0 for uid in cards}
+    errors = duplicates = 0
+    for uid, reply, _ in results:
+        if "error" in reply:
+            errors += 1
+            print("  %s: %s" % (uid, reply["error"]), file=sys.stderr)
+        elif reply.get("duplicate"):
+            duplicates += 1
+        else:
+            stored[uid] += 1
+
+    latencies = sorted(latency for _, _, latency in results)
+    percentile = lambda p: latencies[min(len(latencies) - 1, int(p * len(latencies)))]
+    print("%d posts in %.1f s: %d stored, %d duplicates dropped, %d errors" %
+          (len(results), elapsed, sum(stored.values()), duplicates, errors))
+    print("latency ms: median %.0f, p90 %.0f, p99 %.0f, max %.0f, mean %.0f" %
+          (percentile(0.5), percentile(0.9), percentile(0.99), latencies[-1], statistics.mean(latencies)))
+
+    separator = "&" if "?" in args.exec_url else "?"
+    query = urllib.parse.urlencode({"token": args.token, "prefix": run})
+    response = http_request("%s%saudit&%s" % (args.exec_url, separator, query))
+    if "error" in response:
+        print("audit refused: %s" % response["error"])
+        sys.exit(1)
+    audit = response.get("uids", {})
+    failures = 0
+    for uid in cards:
+        expected = {"rows": math.ceil(stored[uid] / 2), "open": stored[uid] % 2}
+        actual = audit.get(uid, {"rows": 0, "open": 0})
+        if actual != expected:
+            failures += 1
+            print("  %s: stored %d times, expected %s, sheet has %s" % (uid, stored[uid], expected, actual))
+    print("audit: %d of %d cards consistent" % (len(cards) - failures, len(cards)))
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""
+Baked Roster Generator
+Turns a CSV export of the Database sheet into src/baked_roster_data.h
+
+The header holds a sorted, flash-resident member table that the firmware uses
+as its initial roster when built with -D USE_BAKED_ROSTER=1 (see baked_roster.h).
+Rows are read the way doGet reads them: columns B:E (UID, DLSU ID, name,
+Discord username) from row 8 down, and only complete rows are kept.
+
+Usage:
+  gen_roster.py Database.csv [-o src/baked_roster_data.h]
+"""
+
+import argparse
+import csv
+import os
+import re
+import sys
+
+FIELD_LIMIT = 255
+UID_MAX_BYTES = 10
+
+
+def normalize_uid(text):
+    """UID formatted like format_uid(), or None if it is not hex byte pairs"""
+    digits = re.sub(r"[^0-9A-Fa-f]", "", text)
+    if not digits or len(digits) % 2 or len(digits) > UID_MAX_BYTES * 2:
+        return None
+    return " ".join(digits[i:i + 2] for i in range(0, len(digits), 2)).upper()
+
+
+def c_string(text):
+    """C string literal; octal escapes cannot swallow a following digit the way \\x can"""
+    out = []
+    for byte in text.encode()[:FIELD_LIMIT]:
+        if byte in (0x22, 0x5C) or byte < 0x20 or byte > 0x7E:
+            out.append("\\%03o" % byte)
+        else:
+            out.append(chr(byte))
+    return '"' + "".join(out) + '"'
+
+
+def fnv1a(data):
+    """Same hash as roster_version() in data_map.h"""
+    value = 2166136261
+    for byte in data:
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def read_members(path, start_row, start_col):
+    members = {}
+    with open(path, newline="", encoding="utf-8-sig") as handle:
+        for number, row in enumerate(csv.reader(handle), start=1):
+            if number < start_row:
+                continue
+            cells = [cell.strip() for cell in row[start_col:start_col + 4]]
+            if len(cells) < 4 or any(cell == "" for cell in cells):
+                continue
+            uid = normalize_uid(cells[0])
+            if uid is None:
+                print("row %d: skipping unparseable UID %r" % (number, cells[0]), file=sys.stderr)
+                continue
+            if uid in members:
+                print("row %d: duplicate UID %s, keeping the first" % (number, uid), file=sys.stderr)
+                continue
+            members[uid] = cells[1:]
+    return members
+
+
+def render(members, source):
+    rows = []
+    for uid in sorted(members):
+        dlsu_id, name, discord_username = members[uid]
+        rows.append("    {%s, %s, %s, %s}," % (c_string(uid), c_string(dlsu_id), c_string(name),
+                                              c_string(discord_username)))
+    body = "\n".join(rows)
+    version = fnv1a(body.encode())
+
+    return """// Generated by tools/gen_roster.py from %s - do not edit
+// Sorted by UID text (strcmp order) for baked_roster_find()
+
+#pragma once
+
+#define BAKED_ROSTER_COUNT %d
+#define BAKED_ROSTER_VERSION 0x%08XUL
+
+constexpr BakedMember PROGMEM baked_roster[BAKED_ROSTER_COUNT > 0 ? BAKED_ROSTER_COUNT : 1] = {
+%s
+};
+""" % (os.path.basename(source), len(rows), version, body if rows else '    {"", "", "", ""},')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("csv", help="CSV export of the Database sheet")
+    parser.add_argument("-o", "--output", default=os.path.join(os.path.dirname(__file__), "..", "src",
+                                                               "baked_roster_data.h"))
+    parser.add_argument("--start-row", type=int, default=8, help="first data row (1-based, default 8)")
+    parser.add_argument("--start-col", default="B", help="UID column letter (default B)")
+    args = parser.parse_args()
+
+    start_col = ord(args.start_col.upper()) - ord("A")
+    members = read_members(args.csv, args.start_row, start_col)
+    with open(args.output, "w", encoding="utf-8") as handle:
+        handle.write(render(members, args.csv))
+    print("%d members written to %s" % (len(members), os.path.normpath(args.output)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+"""
+MQTT to Sheets Bridge
+Connects gates built with -D MQTT_TRANSPORT=1 to the Apps Script web app
+
+  <prefix>/+/scan       scan events from the gates, POSTed to doPost as they arrive
+  <prefix>/roster/delta roster edits polled from doGet ?changes&since=<seq> and
+                        published with QoS 1, so gates apply them within seconds
+
+The last published change sequence is kept in --state, so a restarted bridge
+resumes where it stopped. Scan events are written to --spool before the broker
+gets its PUBACK and stay there until doPost has taken them, so neither a
+doPost outage nor a bridge restart loses one. doPost drops events it already
+stored, which makes the at-least-once redeliveries harmless.
+
+Needs paho-mqtt (pip install paho-mqtt). Against a local broker:
+  mosquitto -v
+  mqtt_sheets_bridge.py --exec https://script.google.com/macros/s/<id>/exec
+"""
+
+import argparse
+import collections
+import json
+import os
+import sys
+import threading
+import time
+import urllib.error
+import urllib.request
+
+RETRY_DELAYS = (1, 2, 4, 8)
+
+# doPost errors that a retry cannot fix
+PERMANENT_ERRORS = ("unknown user",)
+
+
+def http_request(url, body=None, timeout=30):
+    """GET or POST (when body is given) and return the decoded response; urllib follows the echo redirect"""
+    data = body.encode() if body is not None else None
+    request = urllib.request.Request(url, data=data, headers={"Content-Type": "application/json"})
+    with urllib.request.urlopen(request, timeout=timeout) as response:
+        return response.read().decode()
+
+
+def load_seq(path):
+    try:
+        with open(path) as handle:
+            return int(handle.read().strip() or 0)
+    except (OSError, ValueError):
+        return 0
+
+
+def save_seq(path, seq):
+    temp = path + ".tmp"
+    with open(temp, "w") as handle:
+        handle.write(str(seq))
+    os.replace(temp, path)
+
+
+class ScanSpool:
+    """Scan events waiting for doPost, one JSON body per line, kept on disk in arrival order"""
+
+    def __init__(self, path):
+        self.path = path
+        self.events = collections.deque()
+        self.ready = threading.Condition()
+        try:
+            with open(path) as handle:
+                self.events.extend(line.rstrip("\n") for line in handle if line.strip())
+        except OSError:
+            pass
+        if self.events:
+            print("Resuming %d spooled scan events" % len(self.events), flush=True)
+
+    def push(self, body):
+        """Store an event durably; called before the broker is acknowledged"""
+        body = body.replace("\n", " ")
+        with self.ready:
+            with open(self.path, "a") as handle:
+                handle.write(body + "\n")
+                handle.flush()
+                os.fsync(handle.fileno())
+            self.events.append(body)
+            self.ready.notify()
+
+    def peek(self):
+        """Oldest event, waiting for one to arrive"""
+        with self.ready:
+            while not self.events:
+                self.ready.wait()
+            return self.events[0]
+
+    def pop(self):
+        """Forget the oldest event once doPost has taken it"""
+        with self.ready:
+            self.events.popleft()
+            temp = self.path + ".tmp"
+            with open(temp, "w") as handle:
+                handle.writelines(body + "\n" for body in self.events)
+                handle.flush()
+                os.fsync(handle.fileno())
+            os.replace(temp, self.path)
+
+
+def post_scan(exec_url, body):
+    """POST one event; returns an error message worth retrying, or None once doPost has taken it"""
+    try:
+        reply = http_request(exec_url, body)
+        result = json.loads(reply)
+    except (urllib.error.URLError, OSError, ValueError) as error:
+        return "doPost failed: %s" % error
+    # Lock timeouts and sheet errors come back as {"error": ...}
+    error = result.get("error") if isinstance(result, dict) else None
+    if error and error not in PERMANENT_ERRORS:
+        return "doPost error: %s" % error
+    print("scan -> doPost %s" % reply.strip()[:120], flush=True)
+    return None
+
+
+def deliver_scans(spool, exec_url):
+    """Post spooled events to doPost in order, retrying each until it is stored"""
+    while True:
+        body = spool.peek()
+        attempt = 0
+        error = post_scan(exec_url, body)
+        while error is not None:
+            delay = RETRY_DELAYS[min(attempt, len(RETRY_DELAYS) - 1)]
+            print("%s, retrying in %ds (%d waiting)" % (error, delay, len(spool.events)), file=sys.stderr, flush=True)
+            time.sleep(delay)
+            attempt += 1
+            error = post_scan(exec_url, body)
+        spool.pop()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--exec", required=True, dest="exec_url", help="Apps Script web app /exec URL")
+    parser.add_argument("--broker", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--username")
+    parser.add_argument("--password")
+    parser.add_argument("--prefix", default="gate", help="topic prefix (MQTT_TOPIC_PREFIX)")
+    parser.add_argument("--poll", type=float, default=5.0, help="seconds between roster change polls")
+    parser.add_argument("--max-delta", type=int, default=1800,
+                        help="largest delta message; keep under the firmware's MQTT_BUFFER_SIZE")
+    parser.add_argument("--state", default="mqtt_bridge.seq", help="file holding the last pushed change seq")
+    parser.add_argument("--spool", default="mqtt_bridge.spool", help="file holding scan events not yet in doPost")
+    args = parser.parse_args()
+
+    try:
+        import paho.mqtt.client as mqtt
+    except ImportError:
+        sys.exit("paho-mqtt is required (pip install paho-mqtt)")
+
+    spool = ScanSpool(args.spool)
+    threading.Thread(target=deliver_scans, args=(spool, args.exec_url), daemon=True).start()
+
+    def forward_scan(client, userdata, message):
+        # Runs on the network thread; the PUBACK goes out once this returns, so the event is on disk first
+        spool.push(message.payload.decode(errors="replace"))
+        print("%s spooled, %d waiting for doPost" % (message.topic, len(spool.events)), flush=True)
+
+    def on_connect(client, userdata, flags, reason_code, properties=None):
+        client.subscribe(args.prefix + "/+/scan", qos=1)
+        print("Connected to %s:%d" % (args.broker, args.port), flush=True)
+
+    client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, client_id="gate-sheets-bridge", clean_session=False)
+    if args.username:
+        client.username_pw_set(args.username, args.password)
+    client.on_connect = on_connect
+    client.message_callback_add(args.prefix + "/+/scan", forward_scan)
+    client.connect(args.broker, args.port, keepalive=30)
+    client.loop_start()
+
+    seq = load_seq(args.state)
+    delta_topic = args.prefix + "/roster/delta"
+    separator = "&" if "?" in args.exec_url else "?"
+    try:
+        while True:
+            try:
+                reply = json.loads(http_request("%s%schanges&since=%d" % (args.exec_url, separator, seq)))
+            except (urllib.error.URLError, OSError, ValueError) as error:
+                print("Roster change poll failed: %s" % error, file=sys.stderr)
+                time.sleep(args.poll)
+                continue
+
+            if reply.get("changes") or reply.get("resync"):
+                message = json.dumps(reply, separators=(",", ":"))
+                if len(message) > args.max_delta:
+                    # Too big for the gate's MQTT buffer: have it download the whole roster instead
+                    reply = {"seq": reply["seq"], "changes": [], "resync": True}
+                    message = json.dumps(reply, separators=(",", ":"))
+                info = client.publish(delta_topic, message, qos=1)
+                info.wait_for_publish()
+                print("Pushed roster delta %d: %d changes%s" % (reply["seq"], len(reply.get("changes", [])),
+                                                               ", resync" if reply.get("resync") else ""), flush=True)
+            if reply.get("seq", seq) != seq:
+                seq = reply["seq"]
+                save_seq(args.state, seq)
+            time.sleep(args.poll)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        client.loop_stop()
+        client.disconnect()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,510 @@
+#!/usr/bin/env python3
+"""
+Scan Trace Replayer
+Replays timestamped scan traces against local Apps Script and Discord stand-ins
+
+Subcommands:
+  generate  Write a synthetic trace (bursty arrivals, repeat taps, unknown cards)
+  serve     Run only the HTTP stand-ins (doGet/doPost and the Discord webhook)
+  replay    Replay a trace and report throughput, queueing delay and latency
+
+Replay targets:
+  --serial PORT  A real gate built with -D SCAN_INJECT=1 (the console "scan" command) and
+                 -D STANDIN_HOST='"http://<this-host>:<port>"'; needs pyserial
+  (default)      A host model of the firmware scan loop that makes the same
+                 sequential HTTP calls to the stand-ins and adds the firmware's
+                 fixed buzzer and display delays on a virtual clock
+"""
+
+import argparse
+import base64
+import gzip
+import json
+import random
+import statistics
+import sys
+import threading
+import time
+import urllib.error
+import urllib.request
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+# Fixed delays in the firmware scan path (milliseconds)
+SCAN_BUZZ_MS = 300
+REPEAT_BUZZ_MS = 60
+SUCCESS_BUZZ_MS = 300
+ERROR_BUZZ_MS = 2500
+DENIED_PAUSE_MS = 500
+HALT_PAUSE_MS = 250
+OLED_UPDATE_MS = 25
+SCAN_COOLDOWN_MS = 5000
+
+
+def member_uid(index):
+    """UID of roster member `index`, formatted like format_uid()"""
+    return "EA %02X %02X %02X" % ((index >> 16) & 0xFF, (index >> 8) & 0xFF, index & 0xFF)
+
+
+def unknown_uid(index):
+    """UID of an unregistered card"""
+    return "DE AD %02X %02X" % ((index >> 8) & 0xFF, index & 0xFF)
+
+
+def roster_json(members):
+    """Roster in the doGet JSON shape"""
+    return json.dumps([
+        {
+            "uid": member_uid(i),
+            "dlsu_id": "12%06d" % i,
+            "name": "Member %d" % i,
+            "discord_username": "member%d" % i,
+        }
+        for i in range(members)
+    ])
+
+
+def roster_bin(members, compress=False):
+    """Roster in the doGet ?format=bin encoding (see convertToBinary in app_script.txt)"""
+    data = bytearray(b"GRB\x01")
+    data += members.to_bytes(2, "big")
+    for i in range(members):
+        uid = bytes.fromhex(member_uid(i))
+        data.append(len(uid))
+        data += uid
+        for field in ("12%06d" % i, "Member %d" % i, "member%d" % i):
+            encoded = field.encode()[:255]
+            data.append(len(encoded))
+            data += encoded
+    if compress:
+        data = gzip.compress(bytes(data))
+    return base64.b64encode(bytes(data)).decode()
+
+
+# ---------------------------------------------------------------------------
+# Trace generation
+# ---------------------------------------------------------------------------
+
+def generate_trace(args):
+    """Generate a trace of bursty arrivals with repeat taps and unknown cards"""
+    rng = random.Random(args.seed)
+    events = []
+    duration_ms = args.duration * 1000
+    members = list(range(args.members))
+    rng.shuffle(members)
+    arrivals = members[:args.arrivals]
+
+    # Arrivals come in bursts: pick burst centres, then spread members around them
+    bursts = [rng.uniform(0, duration_ms) for _ in range(max(1, args.bursts))]
+    for member in arrivals:
+        centre = rng.choice(bursts)
+        t = min(max(0.0, rng.gauss(centre, args.burst_spread * 1000)), duration_ms)
+        reader = rng.choice(args.readers)
+        events.append((t, reader, member_uid(member)))
+
+        # Nervous double taps right after the first read
+        if rng.random() < args.repeat_rate:
+            events.append((t + rng.uniform(150, 2500), reader, member_uid(member)))
+
+    for n in range(int(args.arrivals * args.unknown_rate)):
+        t = rng.uniform(0, duration_ms)
+        card = unknown_uid(rng.randrange(max(1, args.unknown_cards)))
+        events.append((t, rng.choice(args.readers), card))
+
+    events.sort()
+    with open(args.output, "w") as out:
+        for t, reader, uid in events:
+            out.write(json.dumps({"t_ms": int(t), "reader": reader, "uid": uid}) + "\n")
+    print("Wrote %d events to %s" % (len(events), args.output))
+
+
+def load_trace(path):
+    """Read a trace of {"t_ms", "reader", "uid"} JSON lines"""
+    events = []
+    with open(path) as trace:
+        for line in trace:
+            line = line.strip()
+            if line:
+                event = json.loads(line)
+                events.append((int(event["t_ms"]), int(event.get("reader", 0)), event["uid"]))
+    events.sort()
+    return events
+
+
+# ---------------------------------------------------------------------------
+# HTTP stand-ins
+# ---------------------------------------------------------------------------
+
+class StandIns:
+    """Shared configuration and request log for the stand-in handlers"""
+
+    def __init__(self, args):
+        self.roster = roster_json(args.members)
+        self.roster_bin = roster_bin(args.members)
+        self.roster_gzip = roster_bin(args.members, compress=True)
+        self.apps_latency = (args.apps_latency, args.apps_jitter)
+        self.discord_latency = (args.discord_latency, args.discord_jitter)
+        self.apps_error_rate = args.apps_error_rate
+        self.discord_error_rate = args.discord_error_rate
+        self.rng = random.Random(args.seed)
+        self.lock = threading.Lock()
+        self.requests = []
+        self.echoes = {}
+        self.echo_seq = 0
+
+    def delay(self, latency):
+        mean, jitter = latency
+        with self.lock:
+            wait = max(0.0, self.rng.gauss(mean, jitter))
+        time.sleep(wait / 1000.0)
+
+    def fails(self, rate):
+        with self.lock:
+            return self.rng.random() < rate
+
+    def record(self, kind, body):
+        with self.lock:
+            self.requests.append((time.monotonic(), kind, body))
+
+    def park_echo(self, body):
+        """Store a script result behind a single-use echo key, like script.googleusercontent.com"""
+        with self.lock:
+            self.echo_seq += 1
+            key = "standin-%d" % self.echo_seq
+            self.echoes[key] = body
+            # POST results are only fetched when the gate asked for a notification; expire the oldest
+            while len(self.echoes) > 256:
+                self.echoes.pop(next(iter(self.echoes)))
+        return key
+
+    def take_echo(self, key):
+        with self.lock:
+            return self.echoes.pop(key, None)
+
+
+def make_handler(standins):
+    class Handler(BaseHTTPRequestHandler):
+        # Keep-alive, so the firmware can reuse its connections as it does with Google
+        protocol_version = "HTTP/1.1"
+
+        def log_message(self, format, *args):
+            pass
+
+        def reply(self, code, body, content_type="application/json"):
+            data = body.encode()
+            self.send_response(code)
+            self.send_header("Content-Type", content_type)
+            self.send_header("Content-Length", str(len(data)))
+            self.end_headers()
+            self.wfile.write(data)
+
+        def redirect_to_echo(self, body):
+            # Apps Script runs the script on /exec and answers 302 to the output
+            key = standins.park_echo(body)
+            self.send_response(302)
+            self.send_header("Location", "http://%s/macros/echo?user_content_key=%s" % (self.headers["Host"], key))
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+
+        def do_GET(self):
+            if self.path.startswith("/macros/echo"):
+                body = standins.take_echo(self.path.rpartition("user_content_key=")[2])
+                if body is None:
+                    return self.reply(404, "{}")
+                return self.reply(200, body)
+            if "/macros/s/" not in self.path:
+                return self.reply(404, "{}")
+            standins.delay(standins.apps_latency)
+            standins.record("doGet", self.path)
+            if "format=bin" not in self.path:
+                return self.redirect_to_echo(standins.roster)
+            compressed = "gzip=1" in self.path
+            self.redirect_to_echo(standins.roster_gzip if compressed else standins.roster_bin)
+
+        def do_POST(self):
+            length = int(self.headers.get("Content-Length", 0))
+            body = self.rfile.read(length).decode(errors="replace")
+            if "/macros/s/" in self.path:
+                standins.delay(standins.apps_latency)
+                if standins.fails(standins.apps_error_rate):
+                    return self.reply(500, "{}")
+                standins.record("doPost", body)
+                # The stand-in posts nothing to Discord itself, so the gate falls back to its webhook
+                return self.redirect_to_echo('{"action":"time in","notified":false}')
+            if "/api/webhooks/" in self.path:
+                standins.delay(standins.discord_latency)
+                if standins.fails(standins.discord_error_rate):
+                    return self.reply(429, "{}")
+                standins.record("discord", body)
+                self.send_response(204)
+                self.end_headers()
+                return
+            self.reply(404, "{}")
+
+    return Handler
+
+
+def start_standins(args):
+    standins = StandIns(args)
+    server = ThreadingHTTPServer((args.host, args.port), make_handler(standins))
+    thread = threading.Thread(target=server.serve_forever, daemon=True)
+    thread.start()
+    print("Stand-ins listening on http://%s:%d" % (args.host, args.port))
+    return standins, server
+
+
+def serve(args):
+    start_standins(args)
+    try:
+        while True:
+            time.sleep(3600)
+    except KeyboardInterrupt:
+        pass
+
+
+# ---------------------------------------------------------------------------
+# Replay targets
+# ---------------------------------------------------------------------------
+
+def http_post(url, body):
+    """POST and return elapsed milliseconds and whether it succeeded"""
+    request = urllib.request.Request(url, data=body.encode(), headers={"Content-Type": "application/json"})
+    start = time.monotonic()
+    try:
+        with urllib.request.urlopen(request, timeout=15) as response:
+            ok = response.status < 400
+    except (urllib.error.URLError, OSError):
+        ok = False
+    return (time.monotonic() - start) * 1000.0, ok
+
+
+def result(uid, outcome, arrival_ms, picked_ms, done_ms):
+    """One replayed scan, times in milliseconds from the start of the replay"""
+    return {
+        "uid": uid,
+        "outcome": outcome,
+        "arrival_ms": arrival_ms,
+        "done_ms": done_ms,
+        "queue_ms": picked_ms - arrival_ms,
+        "e2e_ms": done_ms - arrival_ms,
+    }
+
+
+def replay_model(events, args):
+    """Model of the firmware loop: one scan at a time, sequential HTTP calls"""
+    base = "http://127.0.0.1:%d" % args.port
+    apps_url = base + "/macros/s/standin/exec"
+    discord_url = base + "/api/webhooks/standin"
+    known = set(member_uid(i) for i in range(args.members))
+    recent = {}
+    results = []
+    clock = 0.0
+
+    for t_ms, reader, uid in events:
+        # A card held to a busy gate is picked up once the loop is free again
+        start = max(clock, float(t_ms))
+        service = 0.0
+
+        last = recent.get(uid)
+        if last is not None and start - last < SCAN_COOLDOWN_MS:
+            recent[uid] = start
+            service += REPEAT_BUZZ_MS
+            clock = start + service
+            results.append(result(uid, "suppressed", t_ms, start, clock))
+            continue
+        recent[uid] = start
+
+        service += SCAN_BUZZ_MS + OLED_UPDATE_MS
+        payload = json.dumps({"uid": uid, "access_granted": uid in known, "reader": reader})
+        if uid in known:
+            elapsed, _ = http_post(discord_url, "{\"content\":\"\",\"embeds\":[]}")
+            service += elapsed
+            elapsed, _ = http_post(apps_url, payload)
+            service += elapsed
+            service += OLED_UPDATE_MS + SUCCESS_BUZZ_MS
+            outcome = "granted"
+        else:
+            elapsed, _ = http_post(apps_url, payload)
+            service += elapsed + DENIED_PAUSE_MS
+            elapsed, _ = http_post(discord_url, "{\"content\":\"\",\"embeds\":[]}")
+            service += elapsed
+            service += OLED_UPDATE_MS + ERROR_BUZZ_MS
+            outcome = "denied"
+        service += HALT_PAUSE_MS
+
+        clock = start + service
+        results.append(result(uid, outcome, t_ms, start, clock))
+
+    return results
+
+
+def replay_serial(events, args):
+    """Drive a real gate over its serial console in real time"""
+    try:
+        import serial
+    except ImportError:
+        sys.exit("pyserial is required for --serial (pip install pyserial)")
+
+    port = serial.Serial(args.serial, args.baud, timeout=0.05)
+    pending = {}
+    results = []
+    lock = threading.Lock()
+    done = threading.Event()
+
+    def reader_thread():
+        buffer = b""
+        while not done.is_set() or pending:
+            buffer += port.read(256)
+            while b"\n" in buffer:
+                raw, buffer = buffer.split(b"\n", 1)
+                line = raw.decode(errors="replace").strip()
+                now = time.monotonic()
+                with lock:
+                    if line.startswith("Scan injected - UID: "):
+                        uid = line[len("Scan injected - UID: "):].split(" (reader")[0]
+                        if uid in pending and "picked_at" not in pending[uid][0]:
+                            pending[uid][0]["picked_at"] = now
+                    elif line.startswith("Repeat scan ignored - UID: "):
+                        uid = line[len("Repeat scan ignored - UID: "):].split(" (")[0]
+                        finish(uid, now, "suppressed")
+                    elif line.startswith("Scan complete - UID: "):
+                        uid = line[len("Scan complete - UID: "):].split(" in ")[0]
+                        finish(uid, now, "completed")
+            if done.is_set() and time.monotonic() > deadline[0]:
+                break
+
+    def finish(uid, now, outcome):
+        if uid not in pending:
+            return
+        entry = pending[uid].pop(0)
+        if not pending[uid]:
+            del pending[uid]
+        picked = entry.get("picked_at", now)
+        results.append(result(uid, outcome, (entry["sent_at"] - start) * 1000.0,
+                              (picked - start) * 1000.0, (now - start) * 1000.0))
+
+    deadline = [float("inf")]
+    start = time.monotonic()
+    thread = threading.Thread(target=reader_thread, daemon=True)
+    thread.start()
+
+    for t_ms, reader, uid in events:
+        wait = start + t_ms / 1000.0 - time.monotonic()
+        if wait > 0:
+            time.sleep(wait)
+        with lock:
+            pending.setdefault(uid, []).append({"sent_at": time.monotonic()})
+        port.write(("scan %d %s\n" % (reader, uid)).encode())
+
+    deadline[0] = time.monotonic() + args.drain
+    done.set()
+    thread.join()
+    port.close()
+    return results
+
+
+# ---------------------------------------------------------------------------
+# Reporting
+# ---------------------------------------------------------------------------
+
+def percentile(values, pct):
+    if not values:
+        return 0.0
+    ordered = sorted(values)
+    rank = max(0, min(len(ordered) - 1, int(round(pct / 100.0 * len(ordered) + 0.5)) - 1))
+    return ordered[rank]
+
+
+def report(results, standins, args):
+    processed = [r for r in results if r["outcome"] != "suppressed"]
+    summary = {
+        "events": len(results),
+        "by_outcome": {},
+        "sustained_scans_per_min": 0.0,
+        "queue_ms": {},
+        "e2e_ms": {},
+        "standin_requests": {},
+    }
+    for r in results:
+        summary["by_outcome"][r["outcome"]] = summary["by_outcome"].get(r["outcome"], 0) + 1
+
+    if processed:
+        # Busy span from the first arrival to the last completion
+        span_ms = max(1.0, max(r["done_ms"] for r in results) - min(r["arrival_ms"] for r in results))
+        summary["sustained_scans_per_min"] = round(len(processed) / (span_ms / 60000.0), 2)
+
+    for key in ("queue_ms", "e2e_ms"):
+        values = [r[key] for r in results]
+        summary[key] = {
+            "p50": round(percentile(values, 50), 1),
+            "p95": round(percentile(values, 95), 1),
+            "p99": round(percentile(values, 99), 1),
+            "max": round(max(values), 1) if values else 0.0,
+            "mean": round(statistics.mean(values), 1) if values else 0.0,
+        }
+
+    for _, kind, _ in standins.requests:
+        summary["standin_requests"][kind] = summary["standin_requests"].get(kind, 0) + 1
+
+    print(json.dumps(summary, indent=2))
+
+
+def replay(args):
+    standins, server = start_standins(args)
+    events = load_trace(args.trace)
+    if args.serial:
+        results = replay_serial(events, args)
+    else:
+        results = replay_model(events, args)
+    server.shutdown()
+    report(results, standins, args)
+
+
+def add_standin_options(parser):
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--members", type=int, default=60, help="roster size served by doGet")
+    parser.add_argument("--apps-latency", type=float, default=1800, help="mean doGet/doPost latency (ms)")
+    parser.add_argument("--apps-jitter", type=float, default=400)
+    parser.add_argument("--apps-error-rate", type=float, default=0.0)
+    parser.add_argument("--discord-latency", type=float, default=350, help="mean webhook latency (ms)")
+    parser.add_argument("--discord-jitter", type=float, default=100)
+    parser.add_argument("--discord-error-rate", type=float, default=0.0)
+    parser.add_argument("--seed", type=int, default=1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    gen = sub.add_parser("generate", help="write a synthetic trace")
+    gen.add_argument("--output", default="trace.jsonl")
+    gen.add_argument("--members", type=int, default=60)
+    gen.add_argument("--arrivals", type=int, default=40)
+    gen.add_argument("--duration", type=int, default=300, help="trace length (s)")
+    gen.add_argument("--bursts", type=int, default=3)
+    gen.add_argument("--burst-spread", type=float, default=20, help="stddev around a burst (s)")
+    gen.add_argument("--repeat-rate", type=float, default=0.15)
+    gen.add_argument("--unknown-rate", type=float, default=0.1)
+    gen.add_argument("--unknown-cards", type=int, default=3)
+    gen.add_argument("--readers", type=int, nargs="+", default=[0])
+    gen.add_argument("--seed", type=int, default=1)
+    gen.set_defaults(func=generate_trace)
+
+    srv = sub.add_parser("serve", help="run the HTTP stand-ins")
+    add_standin_options(srv)
+    srv.set_defaults(func=serve)
+
+    rep = sub.add_parser("replay", help="replay a trace")
+    rep.add_argument("trace")
+    rep.add_argument("--serial", help="serial port of a SCAN_INJECT gate")
+    rep.add_argument("--baud", type=int, default=9600)
+    rep.add_argument("--drain", type=float, default=60, help="seconds to wait for the gate after the last event")
+    add_standin_options(rep)
+    rep.set_defaults(func=replay)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()